@@ -17,14 +17,38 @@ CREATE USER IF NOT EXISTS 'user_744'@'localhost' IDENTIFIED BY 'key_744';
 -- Grant all privileges on the key_value_DB_744 database to this user
 GRANT ALL PRIVILEGES ON key_value_DB_744.* TO 'user_744'@'localhost';
 
+-- Let the server read the binary log (--binlog=1 cache invalidation across several servers)
+GRANT REPLICATION SLAVE, REPLICATION CLIENT ON *.* TO 'user_744'@'localhost';
+
 -- Apply privilege changes immediately
 FLUSH PRIVILEGES;
 
 -- Use the key_value_DB_744 database
 USE key_value_DB_744;
 
--- Create the table structure used by the C++ server
-CREATE TABLE IF NOT EXISTS key_value_table (k VARCHAR(255) PRIMARY KEY, v TEXT );
+-- Create the table structure used by the C++ server, `ver` is the version of the value (grows on every write)
+CREATE TABLE IF NOT EXISTS key_value_table (k VARCHAR(255) PRIMARY KEY, v TEXT, ver BIGINT UNSIGNED NOT NULL DEFAULT 0 );
+
+-- Partition tables for ./bin/server --partitions=N (keys are hashed over key_value_table_0 .. key_value_table_<N-1>)
+-- change @partitions to match the server option, run this script on every mysqld listed in --db-hosts
+SET @partitions = 8;
+
+DROP PROCEDURE IF EXISTS create_kv_partitions;
+DELIMITER //
+CREATE PROCEDURE create_kv_partitions(IN n INT)
+BEGIN
+    DECLARE p INT DEFAULT 0;
+    WHILE p < n DO
+        SET @ddl = CONCAT('CREATE TABLE IF NOT EXISTS key_value_table_', p, ' (k VARCHAR(255) PRIMARY KEY, v TEXT, ver BIGINT UNSIGNED NOT NULL DEFAULT 0)');
+        PREPARE stmt FROM @ddl;
+        EXECUTE stmt;
+        DEALLOCATE PREPARE stmt;
+        SET p = p + 1;
+    END WHILE;
+END //
+DELIMITER ;
+
+CALL create_kv_partitions(@partitions);
 
 -- Done
 SELECT 'key_value_DB_744 setup complete' AS status;
@@ -0,0 +1,118 @@
+/*=============================================================
+        bench_dispatch — task dispatch overhead of the worker pools
+ ===============================================================
+ ./bin/bench_dispatch [--jobs=200000] [--work-ns=2000] [--workers=8,32,128] [--producers=1]
+
+ Compares httplib's ThreadPool with WorkerPool's shared and stealing
+ schedulers. --producers threads (one, like httplib's accept loop) enqueue
+ --jobs tasks that each spin for --work-ns, with no I/O, so what differs
+ between the rows is the cost of getting a task to a worker. Every pool
+ size gets a fresh pool. Reported per run: tasks per second, wall time
+ per task beyond the ideal jobs * work-ns / workers, and the delay from
+ enqueue() until the task started.
+================================================================*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include "httplib.h"
+#include "latency.h"
+#include "worker_pool.h"
+
+using namespace std;
+
+struct BenchConfig {
+    long jobs = 200000;
+    long work_ns = 2000;               // busy loop per task, roughly a cache hit handled end to end
+    vector<int> workers = {8, 32, 128};
+    int producers = 1;
+};
+
+void usage() {
+    cerr << "Usage: ./bench_dispatch [--jobs=<n>] [--work-ns=<ns>] [--workers=<n,n,...>] [--producers=<n>]\n";
+}
+
+bool parse_args(int argc, char *argv[], BenchConfig &cfg) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == string::npos) { usage(); return false; }
+        string name = arg.substr(2, eq - 2), value = arg.substr(eq + 1);
+        if (name == "jobs") cfg.jobs = stol(value);
+        else if (name == "work-ns") cfg.work_ns = stol(value);
+        else if (name == "producers") cfg.producers = max(1, stoi(value));
+        else if (name == "workers") {
+            cfg.workers.clear();
+            stringstream list(value);
+            for (string item; getline(list, item, ',');) cfg.workers.push_back(max(1, stoi(item)));
+        }
+        else { cerr << "Unknown option: " << arg << "\n"; usage(); return false; }
+    }
+    return !cfg.workers.empty();
+}
+
+void spin(long ns) {
+    auto until = chrono::steady_clock::now() + chrono::nanoseconds(ns);
+    while (chrono::steady_clock::now() < until) {}
+}
+
+// push cfg.jobs tasks through `queue` and print one result row
+void run(const string &name, httplib::TaskQueue &queue, int workers, const BenchConfig &cfg) {
+    atomic<long> done{0}, refused{0};
+    LatencyHistogram started;
+    auto t0 = chrono::steady_clock::now();
+    vector<thread> producers;
+    for (int p = 0; p < cfg.producers; p++) {
+        producers.emplace_back([&, p] {
+            for (long i = p; i < cfg.jobs; i += cfg.producers) {
+                auto queued = chrono::steady_clock::now();
+                bool ok = queue.enqueue([&, queued] {
+                    started.record(chrono::steady_clock::now() - queued);
+                    spin(cfg.work_ns);
+                    done++;
+                });
+                if (!ok) { refused++; done++; }
+            }
+        });
+    }
+    for (auto &t : producers) t.join();
+    while (done < cfg.jobs) this_thread::sleep_for(chrono::microseconds(50));
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    queue.shutdown();
+
+    double ideal = (double)cfg.jobs * cfg.work_ns / 1e9 / min<long>(workers, thread::hardware_concurrency());
+    cout << left << setw(10) << name << right << setw(8) << workers
+         << setw(14) << fixed << setprecision(0) << cfg.jobs / secs
+         << setw(14) << setprecision(1) << max(0.0, secs - ideal) * 1e9 / cfg.jobs
+         << setw(10) << started.percentile_us(0.5) << setw(10) << started.percentile_us(0.99)
+         << setw(10) << started.percentile_us(0.999);
+    if (refused) cout << "  (" << refused << " refused)";
+    cout << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    BenchConfig cfg;
+    if (!parse_args(argc, argv, cfg)) return 1;
+    cout << cfg.jobs << " tasks of " << cfg.work_ns << "ns, " << cfg.producers << " producer(s), "
+         << thread::hardware_concurrency() << " cpus\n";
+    cout << left << setw(10) << "pool" << right << setw(8) << "workers" << setw(14) << "tasks/s"
+         << setw(14) << "overhead_ns" << setw(10) << "p50_us" << setw(10) << "p99_us" << setw(10) << "p999_us" << "\n";
+    for (int n : cfg.workers) {
+        {   httplib::ThreadPool pool(n);
+            run("httplib", pool, n, cfg);
+        }
+        for (bool stealing : {false, true}) {
+            WorkerPoolOptions opts;
+            opts.workers = n;
+            opts.stealing = stealing;
+            WorkerPool pool(opts);
+            unique_ptr<httplib::TaskQueue> queue(pool.task_queue());
+            run(stealing ? "stealing" : "shared", *queue, n, cfg);
+        }
+    }
+    return 0;
+}
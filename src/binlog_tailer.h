@@ -0,0 +1,436 @@
+#pragma once
+/*=============================================================
+        Binlog tailer: cache invalidation from row events
+ ===============================================================
+ Connects to a mysqld as a replica (mysql_binlog_open / mysql_binlog_fetch),
+ starting at the current end of the binary log, and decodes the row events
+ of the key_value_table partitions:
+
+   TABLE_MAP_EVENT                    table id → db / table name, column types
+   WRITE/UPDATE/DELETE_ROWS_EVENT     v1 and v2, row images of k, v, ver
+
+ Every changed row is handed to `on_row(key, value or nullptr, version,
+ inserted, before_mark)`,
+ the server uses it to update or invalidate its cache, so writes from other
+ server processes, batch jobs or manual fixes are seen as well.
+
+ A mark lets a caller line the stream up with a snapshot it reads itself:
+ hold_mark() before the read (needs streaming(), so the stream starts in
+ front of it), set_mark(end_position()) after it. Rows of events up to
+ the mark come with before_mark = true, the read may or may not have seen
+ their change already.
+
+ Needs binlog_format=ROW with binlog_row_image=FULL (the MySQL 8 defaults)
+ and REPLICATION SLAVE + REPLICATION CLIENT for the server's user.
+================================================================*/
+#include <sys/socket.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <cstring>
+#include <sstream>
+#include <mysql/mysql.h>
+
+class BinlogTailer {
+public:
+    // value nullptr = the row was deleted, inserted = the key did not exist before (WRITE_ROWS),
+    // before_mark = the event lies before the mark (see hold_mark())
+    using RowCallback = std::function<void(const std::string &key, const std::string *value, uint64_t version, bool inserted,
+                                           bool before_mark)>;
+
+    // `connect` opens a blocking connection, `on_reset` runs when events may have been missed
+    // (the saved position was purged) and the cache can no longer be trusted
+    BinlogTailer(std::function<MYSQL *()> connect, std::string database, uint32_t server_id, int heartbeat_ms,
+                 RowCallback on_row, std::function<void()> on_reset)
+        : connect_(std::move(connect)), database_(std::move(database)), server_id_(server_id),
+          heartbeat_ms_(heartbeat_ms), on_row_(std::move(on_row)), on_reset_(std::move(on_reset)) {}
+
+    ~BinlogTailer() { stop(); }
+
+    void start() { thread_ = std::thread([this] { run(); }); }
+
+    void stop() {
+        stopping_ = true;
+        {   std::lock_guard<std::mutex> lk(conn_mu_);
+            if (conn_) ::shutdown(conn_->net.fd, SHUT_RDWR);   // unblocks mysql_binlog_fetch()
+        }
+        if (thread_.joinable()) thread_.join();
+    }
+
+    // the replication stream has been opened, everything committed from now on will be seen
+    bool streaming() const { return streaming_; }
+
+    // every row is reported before_mark until set_mark()
+    void hold_mark() {
+        std::lock_guard<std::mutex> lk(pos_mu_);
+        mark_held_ = true;
+    }
+
+    // rows of events ending after file:pos are reported with before_mark = false
+    void set_mark(const std::string &file, uint64_t pos) {
+        std::lock_guard<std::mutex> lk(pos_mu_);
+        mark_held_ = false;
+        mark_file_ = file;
+        mark_pos_ = pos;
+    }
+
+    // current end of the binary log, read on a connection of its own
+    bool end_position(std::string &file, uint64_t &pos) {
+        MYSQL *conn = connect_();
+        if (!conn) return false;
+        bool ok = current_position(conn, file, pos);
+        mysql_close(conn);
+        return ok;
+    }
+
+    std::string stats_json() const {
+        std::lock_guard<std::mutex> lk(pos_mu_);
+        std::stringstream ss;
+        ss << "{\"file\": \"" << file_ << "\", \"position\": " << pos_ << ", \"events\": " << events_
+           << ", \"row_events\": " << row_events_ << ", \"rows\": " << rows_ << ", \"skipped_events\": " << skipped_
+           << ", \"reconnects\": " << reconnects_ << ", \"resets\": " << resets_
+           << ", \"lag_s\": " << lag_s_ << "}";
+        return ss.str();
+    }
+
+    // decode one event (header included, checksum already stripped); public so it can be fed directly
+    void handle_event(const unsigned char *ev, size_t len) {
+        if (len < HEADER_LEN) return;
+        events_++;
+        uint8_t type = ev[4];
+        uint32_t timestamp = u32(ev), log_pos = u32(ev + 13);
+        if (timestamp) lag_s_ = std::max<long>(0, (long)time(nullptr) - (long)timestamp);
+        const unsigned char *body = ev + HEADER_LEN, *end = ev + len;
+        switch (type) {
+            case ROTATE_EVENT:
+                if (end - body >= 8) {
+                    std::lock_guard<std::mutex> lk(pos_mu_);
+                    pos_ = u64(body);
+                    file_.assign(reinterpret_cast<const char *>(body + 8), end - body - 8);
+                }
+                return;                                  // log_pos of a rotate refers to the old file
+            case FORMAT_DESCRIPTION_EVENT: parse_format(body, end); break;
+            case TABLE_MAP_EVENT: parse_table_map(body, end); break;
+            case WRITE_ROWS_V1: case UPDATE_ROWS_V1: case DELETE_ROWS_V1:
+            case WRITE_ROWS_V2: case UPDATE_ROWS_V2: case DELETE_ROWS_V2:
+                {   std::lock_guard<std::mutex> lk(pos_mu_);   // binlog file names sort in creation order
+                    before_mark_ = mark_held_ || file_ < mark_file_ || (file_ == mark_file_ && log_pos <= mark_pos_);
+                }
+                parse_rows(type, body, end); break;
+            default: break;
+        }
+        if (log_pos) { std::lock_guard<std::mutex> lk(pos_mu_); pos_ = log_pos; }
+    }
+
+private:
+    enum : uint8_t {
+        ROTATE_EVENT = 4, FORMAT_DESCRIPTION_EVENT = 15, TABLE_MAP_EVENT = 19,
+        WRITE_ROWS_V1 = 23, UPDATE_ROWS_V1 = 24, DELETE_ROWS_V1 = 25,
+        WRITE_ROWS_V2 = 30, UPDATE_ROWS_V2 = 31, DELETE_ROWS_V2 = 32,
+    };
+    enum : uint8_t {        // column types that can appear in the partition tables
+        T_TINY = 1, T_SHORT = 2, T_LONG = 3, T_FLOAT = 4, T_DOUBLE = 5, T_LONGLONG = 8, T_INT24 = 9,
+        T_DATE = 10, T_YEAR = 13, T_VARCHAR = 15, T_TIMESTAMP2 = 17, T_DATETIME2 = 18, T_TIME2 = 19,
+        T_BIT = 16, T_JSON = 245, T_NEWDECIMAL = 246, T_ENUM = 247, T_SET = 248, T_BLOB = 252,
+        T_VAR_STRING = 253, T_STRING = 254,
+    };
+    static constexpr size_t HEADER_LEN = 19;
+
+    struct TableInfo {
+        bool ours = false;                  // one of the key_value_table partitions
+        std::vector<uint8_t> types;
+        std::vector<uint16_t> meta;
+    };
+
+    // bounds-checked little-endian reader over one event body
+    struct Reader {
+        const unsigned char *p, *end;
+        bool ok = true;
+        bool need(size_t n) { if ((size_t)(end - p) < n) ok = false; return ok; }
+        uint64_t fixed(size_t n) {
+            if (!need(n)) return 0;
+            uint64_t v = 0;
+            for (size_t i = 0; i < n; i++) v |= (uint64_t)p[i] << (8 * i);
+            p += n;
+            return v;
+        }
+        uint64_t packed() {                 // length-encoded integer
+            if (!need(1)) return 0;
+            uint8_t b = *p++;
+            if (b < 251) return b;
+            if (b == 252) return fixed(2);
+            if (b == 253) return fixed(3);
+            if (b == 254) return fixed(8);
+            ok = false;
+            return 0;
+        }
+        const unsigned char *skip(size_t n) { if (!need(n)) return nullptr; const unsigned char *s = p; p += n; return s; }
+    };
+
+    static uint32_t u32(const unsigned char *p) { return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24; }
+    static uint64_t u64(const unsigned char *p) { return u32(p) | (uint64_t)u32(p + 4) << 32; }
+    static bool bit(const unsigned char *bits, size_t i) { return bits[i / 8] & (1 << (i % 8)); }
+
+    void parse_format(const unsigned char *body, const unsigned char *end) {
+        // binlog_version(2) server_version(50) timestamp(4) header_length(1) post_header_lengths[type - 1]
+        size_t at = 2 + 50 + 4 + 1;
+        post_header_.assign(body + std::min<size_t>(at, end - body), end);
+    }
+
+    size_t post_header_len(uint8_t type, size_t fallback) const {
+        return type - 1u < post_header_.size() ? post_header_[type - 1] : fallback;
+    }
+
+    void parse_table_map(const unsigned char *body, const unsigned char *end) {
+        Reader r{body, end};
+        uint64_t table_id = r.fixed(post_header_len(TABLE_MAP_EVENT, 8) == 6 ? 4 : 6);
+        r.skip(2);                                           // flags
+        size_t db_len = r.fixed(1);
+        const unsigned char *db = r.skip(db_len + 1);
+        size_t tbl_len = r.fixed(1);
+        const unsigned char *tbl = r.skip(tbl_len + 1);
+        uint64_t cols = r.packed();
+        const unsigned char *types = r.skip(cols);
+        uint64_t meta_len = r.packed();
+        const unsigned char *meta = r.skip(meta_len);
+        if (!r.ok) return;
+
+        TableInfo info;
+        std::string table(reinterpret_cast<const char *>(tbl), tbl_len);
+        info.ours = std::string(reinterpret_cast<const char *>(db), db_len) == database_ &&
+                    (table == "key_value_table" ||
+                     (table.rfind("key_value_table_", 0) == 0 && table.size() > 16 &&
+                      table.find_first_not_of("0123456789", 16) == std::string::npos));
+        info.types.assign(types, types + cols);
+        Reader m{meta, meta + meta_len};
+        for (uint8_t t : info.types) {
+            switch (t) {
+                case T_FLOAT: case T_DOUBLE: case T_BLOB: case T_JSON:
+                case T_TIMESTAMP2: case T_DATETIME2: case T_TIME2:
+                    info.meta.push_back(m.fixed(1)); break;
+                case T_VARCHAR: case T_VAR_STRING:
+                    info.meta.push_back(m.fixed(2)); break;
+                case T_BIT: case T_NEWDECIMAL: case T_ENUM: case T_SET: case T_STRING:
+                    info.meta.push_back(m.fixed(2)); break;  // not decoded by value_size(), only kept aligned
+                default:
+                    info.meta.push_back(0);
+            }
+        }
+        tables_[table_id] = std::move(info);
+    }
+
+    // byte size of one column value, 0 when the type is not supported
+    static size_t value_size(uint8_t type, uint16_t meta, const unsigned char *p, const unsigned char *end) {
+        auto prefixed = [&](size_t prefix) -> size_t {
+            if ((size_t)(end - p) < prefix) return 0;
+            uint64_t n = 0;
+            for (size_t i = 0; i < prefix; i++) n |= (uint64_t)p[i] << (8 * i);
+            return prefix + n;
+        };
+        switch (type) {
+            case T_TINY: case T_YEAR: return 1;
+            case T_SHORT: return 2;
+            case T_INT24: case T_DATE: return 3;
+            case T_LONG: case T_FLOAT: return 4;
+            case T_LONGLONG: case T_DOUBLE: return 8;
+            case T_TIMESTAMP2: return 4 + (meta + 1) / 2;
+            case T_DATETIME2: return 5 + (meta + 1) / 2;
+            case T_TIME2: return 3 + (meta + 1) / 2;
+            case T_VARCHAR: case T_VAR_STRING: return prefixed(meta > 255 ? 2 : 1);
+            case T_BLOB: case T_JSON: return prefixed(meta);
+            default: return 0;
+        }
+    }
+
+    // one row image; columns 0, 1, 2 are k, v, ver as created by MySQLStore
+    bool parse_image(Reader &r, const TableInfo &t, const unsigned char *present, size_t cols,
+                     std::string &key, std::string &value, uint64_t &ver) {
+        size_t n_present = 0;
+        for (size_t i = 0; i < cols; i++) n_present += bit(present, i);
+        const unsigned char *nulls = r.skip((n_present + 7) / 8);
+        if (!r.ok) return false;
+        value.clear();                      // a NULL `v` reads as empty, like DBResult does
+        ver = 0;
+        for (size_t i = 0, j = 0; i < cols; i++) {
+            if (!bit(present, i)) continue;
+            bool is_null = bit(nulls, j++);
+            if (is_null) continue;
+            size_t n = value_size(t.types[i], t.meta[i], r.p, r.end);
+            const unsigned char *v = n ? r.skip(n) : nullptr;
+            if (!v) return false;
+            size_t prefix = (t.types[i] == T_VARCHAR || t.types[i] == T_VAR_STRING) ? (t.meta[i] > 255 ? 2 : 1)
+                          : (t.types[i] == T_BLOB ? t.meta[i] : 0);
+            if (i == 0) key.assign(reinterpret_cast<const char *>(v + prefix), n - prefix);
+            else if (i == 1) value.assign(reinterpret_cast<const char *>(v + prefix), n - prefix);
+            else if (i == 2 && t.types[i] == T_LONGLONG) ver = u64(v);
+        }
+        return true;
+    }
+
+    void parse_rows(uint8_t type, const unsigned char *body, const unsigned char *end) {
+        bool v2 = type >= WRITE_ROWS_V2;
+        size_t post = post_header_len(type, v2 ? 10 : 8);
+        Reader r{body, end};
+        uint64_t table_id = r.fixed(post == 6 ? 4 : 6);
+        r.skip(2);                                           // flags
+        if (v2 && post >= 10) {
+            size_t extra = r.fixed(2);                       // includes its own 2 bytes
+            r.skip(extra >= 2 ? extra - 2 : 0);
+        }
+        auto it = tables_.find(table_id);
+        if (!r.ok || it == tables_.end() || !it->second.ours) return;
+        const TableInfo &t = it->second;
+        row_events_++;
+
+        uint64_t cols = r.packed();
+        if (!r.ok || cols != t.types.size()) { skipped_++; return; }
+        const unsigned char *present = r.skip((cols + 7) / 8);
+        bool update = (type == UPDATE_ROWS_V1 || type == UPDATE_ROWS_V2);
+        const unsigned char *present_after = update ? r.skip((cols + 7) / 8) : present;
+        if (!r.ok) { skipped_++; return; }
+
+        while (r.p < r.end) {
+            std::string key, value, after_key, after_value;
+            uint64_t ver = 0, after_ver = 0;
+            if (!parse_image(r, t, present, cols, key, value, ver)) { skipped_++; return; }
+            if (update && !parse_image(r, t, present_after, cols, after_key, after_value, after_ver)) {
+                skipped_++;
+                return;
+            }
+            rows_++;
+            if (type == DELETE_ROWS_V1 || type == DELETE_ROWS_V2) {
+                on_row_(key, nullptr, ver, false, before_mark_);
+            } else if (update) {
+                bool moved = after_key != key;                       // primary key changed: the old key is gone
+                if (moved) on_row_(key, nullptr, ver, false, before_mark_);
+                on_row_(after_key, &after_value, after_ver, moved, before_mark_);
+            } else {
+                on_row_(key, &value, ver, true, before_mark_);
+            }
+        }
+    }
+
+
+    /*---------------------------- replication connection ----------------------------*/
+    bool query_row(MYSQL *conn, const std::string &sql, std::vector<std::string> &row) {
+        if (mysql_query(conn, sql.c_str())) return false;
+        MYSQL_RES *res = mysql_store_result(conn);
+        if (!res) return false;
+        MYSQL_ROW r = mysql_fetch_row(res);
+        unsigned int n = mysql_num_fields(res);
+        row.clear();
+        if (r) for (unsigned int i = 0; i < n; i++) row.push_back(r[i] ? r[i] : "");
+        mysql_free_result(res);
+        return !row.empty();
+    }
+
+    // current end of the binary log (SHOW MASTER STATUS was renamed in 8.2)
+    bool current_position(MYSQL *conn, std::string &file, uint64_t &pos) {
+        std::vector<std::string> row;
+        if (!query_row(conn, "SHOW BINARY LOG STATUS", row) && !query_row(conn, "SHOW MASTER STATUS", row)) return false;
+        file = row[0];
+        pos = strtoull(row[1].c_str(), nullptr, 10);
+        return true;
+    }
+
+    bool open_stream(MYSQL *conn, MYSQL_RPL &rpl, std::string &file, uint64_t pos) {
+        memset(&rpl, 0, sizeof(rpl));
+        rpl.file_name_length = file.size();
+        rpl.file_name = file.c_str();
+        rpl.start_position = pos;
+        rpl.server_id = server_id_;
+        rpl.flags = MYSQL_RPL_SKIP_HEARTBEAT;
+        return mysql_binlog_open(conn, &rpl) == 0;
+    }
+
+    bool setup_session(MYSQL *conn) {
+        // announce that we understand the server's checksum algorithm (both names, the master_ one is pre 8.0.26),
+        // and ask for heartbeats so an idle stream does not run into the connection's read timeout
+        std::vector<std::string> row;
+        if (!query_row(conn, "SELECT @@global.binlog_checksum", row)) return false;
+        checksum_ = (row[0] != "NONE");
+        std::string hb = std::to_string((uint64_t)heartbeat_ms_ * 1000000);
+        return mysql_query(conn, "SET @master_binlog_checksum = @@global.binlog_checksum, "
+                                 "@source_binlog_checksum = @@global.binlog_checksum") == 0 &&
+               mysql_query(conn, ("SET @master_heartbeat_period = " + hb + ", @source_heartbeat_period = " + hb).c_str()) == 0;
+    }
+
+    void run() {
+        mysql_thread_init();
+        std::string file;
+        uint64_t pos = 0;
+        bool first = true;
+        while (!stopping_) {
+            MYSQL *conn = connect_();
+            if (!conn) { std::this_thread::sleep_for(std::chrono::seconds(1)); continue; }
+            {   std::lock_guard<std::mutex> lk(conn_mu_);
+                conn_ = conn;
+            }
+            MYSQL_RPL rpl;
+            bool ok = setup_session(conn);
+            if (ok && first) ok = current_position(conn, file, pos);
+            if (ok && !open_stream(conn, rpl, file, pos)) {
+                // the saved position may have been purged: start over at the end and forget what the cache knows
+                std::cerr << "Binlog tailer: cannot resume at " << file << ":" << pos << " (" << mysql_error(conn) << ")\n";
+                ok = current_position(conn, file, pos) && open_stream(conn, rpl, file, pos);
+                if (ok) { resets_++; on_reset_(); }
+            }
+            if (ok) {
+                if (first) std::cout << "Binlog tailer following " << file << ":" << pos << "\n";
+                first = false;
+                { std::lock_guard<std::mutex> lk(pos_mu_); file_ = file; pos_ = pos; }
+                streaming_ = true;
+                while (!stopping_ && mysql_binlog_fetch(conn, &rpl) == 0 && rpl.size > 0) {
+                    size_t len = rpl.size - 1;                        // buffer[0] is the OK byte
+                    if (checksum_ && len >= HEADER_LEN + 4) len -= 4; // trailing CRC32, already verified by the server
+                    handle_event(rpl.buffer + 1, len);
+                }
+                if (!stopping_) std::cerr << "Binlog tailer: stream ended: " << mysql_error(conn) << "\n";
+                std::lock_guard<std::mutex> lk(pos_mu_);
+                file = file_;
+                pos = pos_;
+            } else if (!stopping_) {
+                std::cerr << "Binlog tailer: cannot start replication stream: " << mysql_error(conn) << "\n";
+            }
+            {   std::lock_guard<std::mutex> lk(conn_mu_);
+                conn_ = nullptr;
+            }
+            mysql_close(conn);
+            if (!stopping_) { reconnects_++; std::this_thread::sleep_for(std::chrono::seconds(1)); }
+        }
+        mysql_thread_end();
+    }
+
+    std::function<MYSQL *()> connect_;
+    const std::string database_;
+    const uint32_t server_id_;
+    const int heartbeat_ms_;
+    RowCallback on_row_;
+    std::function<void()> on_reset_;
+
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+    std::mutex conn_mu_;
+    MYSQL *conn_ = nullptr;
+
+    // decoder state, only touched by the tailer thread
+    bool checksum_ = false;
+    std::vector<uint8_t> post_header_;
+    std::unordered_map<uint64_t, TableInfo> tables_;
+    bool before_mark_ = false;                     // of the rows event being decoded
+
+    mutable std::mutex pos_mu_;                    // guards file_ / pos_ for stats_json(), and the mark
+    std::string file_;
+    uint64_t pos_ = 0;
+    bool mark_held_ = false;
+    std::string mark_file_;                        // empty: no mark, nothing is before it
+    uint64_t mark_pos_ = 0;
+    std::atomic<bool> streaming_{false};
+    std::atomic<long> events_{0}, row_events_{0}, rows_{0}, skipped_{0}, reconnects_{0}, resets_{0}, lag_s_{0};
+};
@@ -0,0 +1,597 @@
+#pragma once
+/*=============================================================
+        Bitcask-style log-structured storage engine
+ ===============================================================
+ Embedded alternative to MySQL (--backend=bitcask).
+
+ On disk  : <data_dir>/<id>.data  append-only segment files
+            <data_dir>/<id>.hint  key index written next to merged segments
+ In memory: keydir  key → {segment id, record offset, record length, seq}
+
+ - PUT     one sequential append to the active segment, concurrent writers
+           share one fdatasync (group commit)
+ - GET     keydir lookup + a single pread of the record
+ - DELETE  appends a tombstone record
+ - merge   background thread rewrites the live records of all immutable
+           segments into fresh segments (+ hint files) once enough of them
+           is dead, then drops the old files
+ - startup segments with a hint file are indexed from the hint, the rest
+           are scanned; a torn tail in the segment that was active is
+           truncated. That is the highest id without a hint file: merge
+           outputs take newer ids than the active segment, but every one
+           of them is published together with its hint
+
+ Record layout (host byte order):
+   crc32(4) | seq(8) | key_len(4) | val_len(4) | key | value
+   crc covers everything after the crc field, val_len = 0xFFFFFFFF marks a tombstone
+ Hint layout: repeated  seq(8) | key_len(4) | rec_len(4) | rec_off(8) | key,  then crc32(4)
+================================================================*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include "kv_store.h"
+
+struct BitcaskOptions {
+    std::string dir = "data/bitcask";       // directory holding segment and hint files
+    uint64_t max_file_bytes = 64ull << 20;  // active segment is rotated past this size
+    bool sync_writes = true;                // fdatasync before a PUT/DELETE is acknowledged
+    double merge_dead_ratio = 0.4;          // merge when this fraction of immutable bytes is dead
+    uint64_t merge_min_dead_bytes = 16ull << 20; // ... and at least this many bytes can be reclaimed
+    int merge_check_ms = 2000;              // how often the merge thread re-evaluates
+};
+
+
+class BitcaskStore : public KVStore {
+public:
+    explicit BitcaskStore(BitcaskOptions opts) : opts_(std::move(opts)) {}
+
+    ~BitcaskStore() override {
+        {   std::lock_guard<std::mutex> lk(merge_mu_);
+            stopping_ = true; }
+        merge_cv_.notify_all();
+        if (merge_thread_.joinable()) merge_thread_.join();
+        std::lock_guard<std::mutex> w(write_mu_);
+        if (active_) ::fdatasync(active_->fd);
+    }
+
+
+    // load every segment into the keydir, open a fresh active segment and start the merge thread
+    bool open(std::string &error) {
+        auto t0 = std::chrono::steady_clock::now();
+        if (!make_dirs(opts_.dir)) {
+            error = "cannot create " + opts_.dir + ": " + strerror(errno);
+            return false;
+        }
+
+        std::vector<uint32_t> ids, hints;
+        DIR *d = ::opendir(opts_.dir.c_str());
+        if (!d) { error = "cannot open " + opts_.dir + ": " + strerror(errno); return false; }
+        while (dirent *e = ::readdir(d)) {
+            std::string n = e->d_name;
+            if (ends_with(n, ".merging")) { ::unlink((opts_.dir + "/" + n).c_str()); continue; } // unfinished merge output
+            if (ends_with(n, ".data")) ids.push_back((uint32_t)std::stoul(n.substr(0, n.size() - 5)));
+            if (ends_with(n, ".hint")) hints.push_back((uint32_t)std::stoul(n.substr(0, n.size() - 5)));
+        }
+        ::closedir(d);
+        std::sort(ids.begin(), ids.end());
+        std::sort(hints.begin(), hints.end());
+        for (uint32_t id : hints)         // merge stopped between publishing the hint and its data file
+            if (!std::binary_search(ids.begin(), ids.end(), id)) ::unlink(hint_path(id).c_str());
+
+        // the segment that was active when the process stopped: the only one that may end in a torn record
+        uint32_t last_active = 0;
+        for (uint32_t id : ids)
+            if (!std::binary_search(hints.begin(), hints.end(), id)) last_active = id;
+
+        // key → seq of the newest tombstone seen so far, only needed while loading
+        std::unordered_map<std::string, uint64_t> deleted;
+        for (uint32_t id : ids) {
+            auto seg = open_segment(id, O_RDWR, error);
+            if (!seg) return false;
+            files_[id] = seg;
+            bool was_active = (id == last_active);
+            if (!(load_hint(*seg, deleted) || scan_into_keydir(*seg, deleted, was_active, error))) return false;
+        }
+        next_file_id_ = ids.empty() ? 1 : ids.back() + 1;
+
+        std::lock_guard<std::mutex> w(write_mu_);
+        if (!ids.empty() && ids.back() == last_active && files_[last_active]->size == 0)
+            active_ = files_[last_active];  // reuse an empty tail segment
+        else if (!rotate_locked(error)) return false;
+        load_ms_ = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+        merge_thread_ = std::thread([this] { merge_loop(); });
+        return true;
+    }
+
+    const char *name() const override { return "bitcask"; }
+
+
+    // the record's sequence number doubles as the version
+    StoreStatus get(const std::string &key, std::string &value, std::string &error, uint64_t *version) override {
+        gets_++;
+        Location loc;
+        std::shared_ptr<Segment> seg;
+        {   std::shared_lock<std::shared_mutex> lk(mu_);
+            auto it = keydir_.find(key);
+            if (it == keydir_.end()) return StoreStatus::NOT_FOUND;
+            loc = it->second;
+            seg = files_.at(loc.file_id);   // keeps the fd open even if a merge drops the file meanwhile
+        }
+        std::string rec(loc.rec_len, '\0');
+        if (!pread_all(seg->fd, &rec[0], rec.size(), loc.rec_off)) {
+            error = "bitcask read failed: " + std::string(strerror(errno));
+            return StoreStatus::ERROR;
+        }
+        Record r;
+        if (!decode(rec.data(), rec.size(), r) || r.tombstone) {
+            error = "bitcask record corrupt in segment " + std::to_string(loc.file_id);
+            return StoreStatus::ERROR;
+        }
+        value.assign(r.value, r.val_len);
+        if (version) *version = loc.seq;
+        return StoreStatus::OK;
+    }
+
+
+    StoreStatus put(const std::string &key, const std::string &value, std::string &error, bool *created, uint64_t *version) override {
+        puts_++;
+        return append(key, &value, error, created, true, version);
+    }
+
+
+    // bulk ingest: append the whole batch, then one fdatasync covers all of it
+    StoreStatus put_many(const std::vector<std::pair<std::string, std::string>> &kvs, std::string &error) override {
+        for (const auto &kv : kvs) {
+            puts_++;
+            if (append(kv.first, &kv.second, error, nullptr, false) == StoreStatus::ERROR) return StoreStatus::ERROR;
+        }
+        uint64_t seq;
+        {   std::lock_guard<std::mutex> w(write_mu_);
+            seq = last_seq_;
+        }
+        if (opts_.sync_writes && !sync_until(seq, error)) return StoreStatus::ERROR;
+        return StoreStatus::OK;
+    }
+
+
+    StoreStatus erase(const std::string &key, std::string &error) override {
+        deletes_++;
+        {   std::shared_lock<std::shared_mutex> lk(mu_);
+            if (!keydir_.count(key)) return StoreStatus::NOT_FOUND; // nothing to delete, no tombstone needed
+        }
+        return append(key, nullptr, error, nullptr);
+    }
+
+
+    // MDELETE: tombstones for the keys that exist, then one fdatasync covers all of them
+    StoreStatus erase_many(const std::vector<std::string> &keys, std::vector<EraseResult> &out, std::string &error) override {
+        out.assign(keys.size(), EraseResult::ABSENT);
+        bool wrote = false;
+        for (size_t i = 0; i < keys.size(); i++) {
+            deletes_++;
+            {   std::shared_lock<std::shared_mutex> lk(mu_);
+                if (!keydir_.count(keys[i])) continue;
+            }
+            if (append(keys[i], nullptr, error, nullptr, false) == StoreStatus::ERROR) return StoreStatus::ERROR;
+            out[i] = EraseResult::DELETED;
+            wrote = true;
+        }
+        uint64_t seq;
+        {   std::lock_guard<std::mutex> w(write_mu_);
+            seq = last_seq_;
+        }
+        if (wrote && opts_.sync_writes && !sync_until(seq, error)) return StoreStatus::ERROR;
+        return StoreStatus::OK;
+    }
+
+
+    std::string stats_json() const override {
+        std::shared_lock<std::shared_mutex> lk(mu_);
+        uint64_t total = 0, dead = 0;
+        for (auto &f : files_) { total += f.second->size; dead += f.second->dead; }
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2);
+        ss << "{\"keys\": " << keydir_.size()
+           << ", \"segments\": " << files_.size()
+           << ", \"disk_bytes\": " << total
+           << ", \"dead_bytes\": " << dead
+           << ", \"gets\": " << gets_ << ", \"puts\": " << puts_ << ", \"deletes\": " << deletes_
+           << ", \"fsyncs\": " << fsyncs_
+           << ", \"writes_per_fsync\": " << (fsyncs_ ? (double)(puts_ + deletes_) / fsyncs_ : 0.0)
+           << ", \"merges\": " << merges_
+           << ", \"merge_reclaimed_bytes\": " << merge_reclaimed_
+           << ", \"hint_files_loaded\": " << hints_loaded_
+           << ", \"startup_ms\": " << load_ms_ << "}";
+        return ss.str();
+    }
+
+
+private:
+    static constexpr uint32_t TOMBSTONE = 0xFFFFFFFFu;
+    static constexpr size_t HEADER = 20;        // crc + seq + key_len + val_len
+    static constexpr size_t HINT_HEADER = 24;   // seq + key_len + rec_len + rec_off
+
+    struct Segment {
+        uint32_t id = 0;
+        int fd = -1;
+        std::string path;
+        uint64_t size = 0;   // bytes in the file
+        uint64_t dead = 0;   // bytes of overwritten records and tombstones (guarded by mu_)
+        ~Segment() { if (fd >= 0) ::close(fd); }
+    };
+
+    struct Location {
+        uint32_t file_id = 0;
+        uint32_t rec_len = 0;
+        uint64_t rec_off = 0;
+        uint64_t seq = 0;
+    };
+
+    struct Record {
+        uint64_t seq = 0;
+        const char *key = nullptr;  uint32_t key_len = 0;
+        const char *value = nullptr; uint32_t val_len = 0;
+        bool tombstone = false;
+        size_t size = 0;            // full encoded length
+    };
+
+
+    //------------------------- encoding helpers -------------------------
+    static void encode(std::string &out, uint64_t seq, const std::string &key, const std::string *value) {
+        uint32_t klen = key.size(), vlen = value ? (uint32_t)value->size() : TOMBSTONE;
+        size_t start = out.size();
+        out.resize(start + HEADER);
+        char *h = &out[start];
+        memcpy(h + 4, &seq, 8);
+        memcpy(h + 12, &klen, 4);
+        memcpy(h + 16, &vlen, 4);
+        out += key;
+        if (value) out += *value;
+        uint32_t crc = crc32(out.data() + start + 4, out.size() - start - 4);
+        memcpy(&out[start], &crc, 4);
+    }
+
+    // decode one record from buf, false on truncation or checksum mismatch
+    static bool decode(const char *buf, size_t avail, Record &r) {
+        if (avail < HEADER) return false;
+        uint32_t crc;
+        memcpy(&crc, buf, 4);
+        memcpy(&r.seq, buf + 4, 8);
+        memcpy(&r.key_len, buf + 12, 4);
+        memcpy(&r.val_len, buf + 16, 4);
+        r.tombstone = (r.val_len == TOMBSTONE);
+        uint64_t body = (uint64_t)r.key_len + (r.tombstone ? 0 : r.val_len);
+        if (HEADER + body > avail) return false;
+        r.size = HEADER + body;
+        if (crc32(buf + 4, r.size - 4) != crc) return false;
+        r.key = buf + HEADER;
+        r.value = buf + HEADER + r.key_len;
+        if (r.tombstone) r.val_len = 0;
+        return true;
+    }
+
+    std::string data_path(uint32_t id) const { return opts_.dir + "/" + std::to_string(id) + ".data"; }
+    std::string hint_path(uint32_t id) const { return opts_.dir + "/" + std::to_string(id) + ".hint"; }
+
+    std::shared_ptr<Segment> open_segment(uint32_t id, int flags, std::string &error) {
+        auto seg = std::make_shared<Segment>();
+        seg->id = id;
+        seg->path = data_path(id);
+        seg->fd = ::open(seg->path.c_str(), flags | O_CLOEXEC, 0644);
+        if (seg->fd < 0) { error = "cannot open " + seg->path + ": " + strerror(errno); return nullptr; }
+        struct stat st;
+        ::fstat(seg->fd, &st);
+        seg->size = st.st_size;
+        return seg;
+    }
+
+    //------------------------- startup -------------------------
+    // hint files only exist for merged segments, which never contain tombstones
+    bool load_hint(Segment &seg, const std::unordered_map<std::string, uint64_t> &deleted) {
+        int fd = ::open(hint_path(seg.id).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        std::string buf;
+        bool ok = read_file(fd, buf);
+        ::close(fd);
+        if (!ok || buf.size() < 4) return false;
+        uint32_t crc;
+        memcpy(&crc, buf.data() + buf.size() - 4, 4);
+        if (crc32(buf.data(), buf.size() - 4) != crc) return false; // damaged hint → fall back to scanning
+
+        size_t pos = 0, end = buf.size() - 4;
+        while (pos + HINT_HEADER <= end) {
+            Location loc;
+            uint32_t klen;
+            loc.file_id = seg.id;
+            memcpy(&loc.seq, buf.data() + pos, 8);
+            memcpy(&klen, buf.data() + pos + 8, 4);
+            memcpy(&loc.rec_len, buf.data() + pos + 12, 4);
+            memcpy(&loc.rec_off, buf.data() + pos + 16, 8);
+            pos += HINT_HEADER;
+            if (pos + klen > end) return false;
+            std::string key(buf.data() + pos, klen);
+            auto d = deleted.find(key);
+            if (d != deleted.end() && d->second > loc.seq) seg.dead += loc.rec_len;  // deleted in a segment loaded earlier
+            else install_loaded(key, loc);
+            pos += klen;
+        }
+        hints_loaded_++;
+        return true;
+    }
+
+    bool scan_into_keydir(Segment &seg, std::unordered_map<std::string, uint64_t> &deleted, bool was_active, std::string &error) {
+        std::string buf;
+        if (!read_file(seg.fd, buf)) { error = "cannot read " + seg.path; return false; }
+        size_t pos = 0;
+        Record r;
+        while (pos < buf.size() && decode(buf.data() + pos, buf.size() - pos, r)) {
+            std::string key(r.key, r.key_len);
+            if (r.tombstone) {
+                seg.dead += r.size;
+                auto it = keydir_.find(key);
+                if (it != keydir_.end() && it->second.seq < r.seq) {
+                    account_dead(it->second);
+                    keydir_.erase(it);
+                }
+                uint64_t &t = deleted[key];
+                t = std::max(t, r.seq);
+            } else {
+                auto d = deleted.find(key);
+                Location loc{seg.id, (uint32_t)r.size, pos, r.seq};
+                if (d != deleted.end() && d->second > r.seq) seg.dead += r.size;  // already deleted later
+                else install_loaded(key, loc);
+            }
+            last_seq_ = std::max(last_seq_, r.seq);
+            pos += r.size;
+        }
+        if (pos < buf.size()) {
+            if (!was_active) { error = "corrupt record in " + seg.path + " at offset " + std::to_string(pos); return false; }
+            // torn write at the end of the active segment before a crash: drop the partial record
+            if (::ftruncate(seg.fd, pos) != 0) { error = "cannot truncate " + seg.path; return false; }
+            seg.size = pos;
+        }
+        return true;
+    }
+
+    // keep the newest version when segments are loaded (merged files may be newer ids than live ones)
+    void install_loaded(const std::string &key, const Location &loc) {
+        auto it = keydir_.find(key);
+        if (it != keydir_.end()) {
+            if (it->second.seq >= loc.seq) { account_dead(loc); return; }
+            account_dead(it->second);
+        }
+        keydir_[key] = loc;
+        last_seq_ = std::max(last_seq_, loc.seq);
+    }
+
+    void account_dead(const Location &old) {
+        auto f = files_.find(old.file_id);
+        if (f != files_.end()) f->second->dead += old.rec_len;
+    }
+
+
+    //------------------------- write path -------------------------
+    // `wait_sync` false leaves the group commit to the caller (put_many syncs once per batch)
+    StoreStatus append(const std::string &key, const std::string *value, std::string &error, bool *created,
+                       bool wait_sync = true, uint64_t *seq_out = nullptr) {
+        uint64_t seq;
+        {   std::lock_guard<std::mutex> w(write_mu_);
+            std::string rec;
+            rec.reserve(HEADER + key.size() + (value ? value->size() : 0));
+            seq = ++last_seq_;
+            encode(rec, seq, key, value);
+            if (active_->size > 0 && active_->size + rec.size() > opts_.max_file_bytes && !rotate_locked(error))
+                return StoreStatus::ERROR;
+            if (!pwrite_all(active_->fd, rec.data(), rec.size(), active_->size)) {
+                error = "bitcask append failed: " + std::string(strerror(errno));
+                return StoreStatus::ERROR;
+            }
+            Location loc{active_->id, (uint32_t)rec.size(), active_->size, seq};
+            std::unique_lock<std::shared_mutex> lk(mu_);
+            active_->size += rec.size();
+            auto it = keydir_.find(key);
+            if (it != keydir_.end()) account_dead(it->second);
+            if (created) *created = (it == keydir_.end());
+            if (value) {
+                if (it != keydir_.end()) it->second = loc;
+                else keydir_.emplace(key, loc);
+            } else {
+                active_->dead += rec.size();     // a tombstone is garbage as soon as a merge runs
+                if (it != keydir_.end()) keydir_.erase(it);
+            }
+        }
+        if (wait_sync && opts_.sync_writes && !sync_until(seq, error)) return StoreStatus::ERROR;
+        if (seq_out) *seq_out = seq;
+        return StoreStatus::OK;
+    }
+
+    // group commit: whoever holds sync_mu_ flushes everything appended so far,
+    // writers that queued up behind it usually find their record already durable
+    bool sync_until(uint64_t seq, std::string &error) {
+        std::lock_guard<std::mutex> lk(sync_mu_);
+        if (synced_seq_ >= seq) return true;
+        std::shared_ptr<Segment> seg;
+        uint64_t target;
+        {   std::lock_guard<std::mutex> w(write_mu_);
+            seg = active_;
+            target = last_seq_;
+        }
+        if (::fdatasync(seg->fd) != 0) { error = "fdatasync failed: " + std::string(strerror(errno)); return false; }
+        fsyncs_++;
+        synced_seq_ = target;
+        return true;
+    }
+
+    // close the active segment (it becomes immutable) and start a new one; caller holds write_mu_
+    bool rotate_locked(std::string &error) {
+        if (active_ && ::fdatasync(active_->fd) == 0) fsyncs_++;   // everything in older segments is durable
+        auto seg = open_segment(next_file_id_++, O_RDWR | O_CREAT, error);
+        if (!seg) return false;
+        fsync_dir(opts_.dir);
+        std::unique_lock<std::shared_mutex> lk(mu_);
+        files_[seg->id] = seg;
+        active_ = seg;
+        return true;
+    }
+
+
+    //------------------------- merge -------------------------
+    void merge_loop() {
+        std::unique_lock<std::mutex> lk(merge_mu_);
+        while (!stopping_) {
+            merge_cv_.wait_for(lk, std::chrono::milliseconds(opts_.merge_check_ms));
+            if (stopping_) break;
+            lk.unlock();
+            if (merge_wanted()) merge();
+            lk.lock();
+        }
+    }
+
+    bool merge_wanted() const {
+        std::shared_lock<std::shared_mutex> lk(mu_);
+        uint64_t total = 0, dead = 0;
+        for (auto &f : files_) {
+            if (f.second == active_) continue;
+            total += f.second->size;
+            dead += f.second->dead;
+        }
+        return dead >= opts_.merge_min_dead_bytes && dead >= opts_.merge_dead_ratio * total;
+    }
+
+    struct Moved { std::string key; Location from, to; };
+
+    // rewrite the live records of every immutable segment, then swap the keydir over
+    void merge() {
+        std::vector<std::shared_ptr<Segment>> inputs;
+        {   std::shared_lock<std::shared_mutex> lk(mu_);
+            for (auto &f : files_) if (f.second != active_) inputs.push_back(f.second);
+        }
+        if (inputs.empty()) return;
+
+        std::vector<Moved> moved;
+        std::vector<std::pair<uint32_t, uint64_t>> outputs;   // id, size
+        std::string data, hint, error;
+        uint32_t out_id = 0;
+        uint64_t reclaimed = 0;
+
+        auto flush_output = [&]() -> bool {
+            if (data.empty()) return true;
+            uint32_t crc = crc32(hint.data(), hint.size());
+            hint.append(reinterpret_cast<const char *>(&crc), 4);
+            if (!write_new_file(data_path(out_id) + ".merging", data) ||
+                !write_new_file(hint_path(out_id) + ".merging", hint)) return false;
+            outputs.emplace_back(out_id, data.size());
+            data.clear();
+            hint.clear();
+            return true;
+        };
+
+        for (auto &seg : inputs) {
+            std::string buf;
+            if (!read_file(seg->fd, buf)) return;
+            size_t pos = 0;
+            Record r;
+            while (pos < buf.size() && decode(buf.data() + pos, buf.size() - pos, r)) {
+                std::string key(r.key, r.key_len);
+                bool live = false;
+                if (!r.tombstone) {
+                    std::shared_lock<std::shared_mutex> lk(mu_);
+                    auto it = keydir_.find(key);
+                    live = it != keydir_.end() && it->second.file_id == seg->id && it->second.rec_off == pos;
+                }
+                if (live) {
+                    if (data.empty() || data.size() + r.size > opts_.max_file_bytes) {
+                        if (!flush_output()) return;
+                        out_id = next_file_id_++;
+                    }
+                    Location to{out_id, (uint32_t)r.size, data.size(), r.seq};
+                    data.append(buf.data() + pos, r.size);
+                    char h[HINT_HEADER];
+                    memcpy(h, &r.seq, 8);
+                    memcpy(h + 8, &r.key_len, 4);
+                    memcpy(h + 12, &to.rec_len, 4);
+                    memcpy(h + 16, &to.rec_off, 8);
+                    hint.append(h, HINT_HEADER);
+                    hint += key;
+                    moved.push_back({std::move(key), Location{seg->id, (uint32_t)r.size, pos, r.seq}, to});
+                } else {
+                    reclaimed += r.size;
+                }
+                pos += r.size;
+            }
+        }
+        if (!flush_output()) return;
+
+        // publish: hint file first, so a merged data file always has one (startup tells the segment that was
+        // active by its missing hint); a hint without its data file is removed on startup
+        std::vector<std::shared_ptr<Segment>> fresh;
+        for (auto &o : outputs) {
+            ::rename((hint_path(o.first) + ".merging").c_str(), hint_path(o.first).c_str());
+            ::rename((data_path(o.first) + ".merging").c_str(), data_path(o.first).c_str());
+            auto seg = open_segment(o.first, O_RDONLY, error);
+            if (!seg) return;
+            fresh.push_back(seg);
+        }
+        fsync_dir(opts_.dir);
+
+        {   std::unique_lock<std::shared_mutex> lk(mu_);
+            for (auto &s : fresh) files_[s->id] = s;
+            for (auto &m : moved) {
+                auto it = keydir_.find(m.key);
+                if (it != keydir_.end() && it->second.file_id == m.from.file_id && it->second.rec_off == m.from.rec_off)
+                    it->second = m.to;
+                else
+                    files_[m.to.file_id]->dead += m.to.rec_len;   // overwritten while the merge was running
+            }
+            for (auto &s : inputs) files_.erase(s->id);
+        }
+        for (auto &s : inputs) {          // readers still holding the segment keep a valid fd
+            ::unlink(s->path.c_str());
+            ::unlink(hint_path(s->id).c_str());
+        }
+        fsync_dir(opts_.dir);
+        merges_++;
+        merge_reclaimed_ += reclaimed;
+    }
+
+
+    BitcaskOptions opts_;
+
+    mutable std::shared_mutex mu_;                              // guards keydir_, files_ and segment dead counters
+    std::unordered_map<std::string, Location> keydir_;
+    std::map<uint32_t, std::shared_ptr<Segment>> files_;
+
+    std::mutex write_mu_;                                       // serializes appends and rotation
+    std::shared_ptr<Segment> active_;
+    uint64_t last_seq_ = 0;
+    std::atomic<uint32_t> next_file_id_{1};
+
+    std::mutex sync_mu_;                                        // group commit leader lock
+    uint64_t synced_seq_ = 0;
+
+    std::mutex merge_mu_;
+    std::condition_variable merge_cv_;
+    bool stopping_ = false;
+    std::thread merge_thread_;
+
+    std::atomic<long> gets_{0}, puts_{0}, deletes_{0}, fsyncs_{0}, merges_{0};
+    std::atomic<uint64_t> merge_reclaimed_{0};
+    long hints_loaded_ = 0, load_ms_ = 0;
+};
@@ -0,0 +1,108 @@
+#pragma once
+/*=============================================================
+             Circuit breaker in front of the storage tier
+ ===============================================================
+ Every store call reports whether it failed or was slow. When too many of
+ the last `window` calls were bad the breaker opens: handlers stop calling
+ the store (cache hits are still served, everything else gets a fast 503)
+ and a background thread probes the store until it answers again.
+================================================================*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <sstream>
+
+struct BreakerOptions {
+    int window = 50;              // most recent calls the failure ratio is computed over
+    int min_calls = 20;           // no decision before this many calls are in the window
+    double failure_ratio = 0.5;   // open when failed + slow calls reach this share of the window
+    int slow_ms = 500;            // a call slower than this counts as bad even if it succeeded
+    int probe_ms = 1000;          // while open, how often the probe is tried
+};
+
+
+class CircuitBreaker {
+public:
+    // `probe` returns true once the store is usable again
+    CircuitBreaker(BreakerOptions opts, std::function<bool()> probe)
+        : opts_(opts), probe_(std::move(probe)), ring_(std::max(1, opts.window), 0) {
+        prober_ = std::thread([this] { probe_loop(); });
+    }
+
+    ~CircuitBreaker() {
+        {   std::lock_guard<std::mutex> lk(mu_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        prober_.join();
+    }
+
+    // false while open: the caller must not touch the store
+    bool allow() {
+        if (!open_.load(std::memory_order_relaxed)) return true;
+        rejected_++;
+        return false;
+    }
+
+    void record(bool ok, std::chrono::steady_clock::duration latency) {
+        bool bad = !ok || latency > std::chrono::milliseconds(opts_.slow_ms);
+        std::lock_guard<std::mutex> lk(mu_);
+        if (open_) return;                        // late results of calls started before the trip
+        if (filled_ == ring_.size()) bad_ -= ring_[pos_];
+        else filled_++;
+        ring_[pos_] = bad;
+        bad_ += bad;
+        pos_ = (pos_ + 1) % ring_.size();
+        if ((int)filled_ >= opts_.min_calls && bad_ >= opts_.failure_ratio * filled_) {
+            open_ = true;
+            trips_++;
+            std::cerr << "Circuit breaker open: " << bad_ << " of the last " << filled_ << " store calls failed or were slow\n";
+            cv_.notify_all();
+        }
+    }
+
+    std::string stats_json() const {
+        std::lock_guard<std::mutex> lk(mu_);
+        std::stringstream ss;
+        ss << "{\"state\": \"" << (open_ ? "open" : "closed") << "\", \"window_bad\": " << bad_ << ", \"window_calls\": " << filled_
+           << ", \"trips\": " << trips_ << ", \"rejected\": " << rejected_ << ", \"probes\": " << probes_ << "}";
+        return ss.str();
+    }
+
+private:
+    void probe_loop() {
+        std::unique_lock<std::mutex> lk(mu_);
+        while (!stopping_) {
+            if (!open_) { cv_.wait(lk); continue; }
+            cv_.wait_for(lk, std::chrono::milliseconds(opts_.probe_ms));
+            if (stopping_) break;
+            lk.unlock();
+            bool ok = probe_();
+            lk.lock();
+            probes_++;
+            if (!ok) continue;
+            std::fill(ring_.begin(), ring_.end(), 0);  // start over with a clean window
+            pos_ = filled_ = bad_ = 0;
+            open_ = false;
+            std::cerr << "Circuit breaker closed: store is answering again\n";
+        }
+    }
+
+    const BreakerOptions opts_;
+    std::function<bool()> probe_;
+    mutable std::mutex mu_;                  // guards the window and the state changes
+    std::condition_variable cv_;
+    std::vector<uint8_t> ring_;              // 1 = failed or slow
+    size_t pos_ = 0, filled_ = 0, bad_ = 0;
+    std::atomic<bool> open_{false};
+    bool stopping_ = false;
+    long trips_ = 0, probes_ = 0;
+    std::atomic<long> rejected_{0};
+    std::thread prober_;
+};
@@ -0,0 +1,224 @@
+/*=============================================================
+        engine_test — restart and crash recovery of the embedded engines
+ ===============================================================
+ ./bin/engine_test [--dir=/tmp/kv_engine_test]
+
+ For bitcask and lsm in turn: writes, overwrites and deletes keys with
+ settings small enough that a merge (bitcask) or a compaction (lsm) runs,
+ writes a few more keys after it, closes the store and cuts the last
+ record in half, like a crash in the middle of an append:
+   bitcask  the tail of the segment that was active (merge outputs have
+            newer ids than it)
+   lsm      the tail of the newest WAL
+ The store is then opened again: it has to open, and every key has to
+ read back as last written, except the torn one, which is not found.
+ Last, an lsm table footer pointing past the end of its file has to fail
+ the open with a "bad table" error.
+ Prints one PASS / FAIL line per check, exit status 1 on any failure.
+================================================================*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "bitcask.h"
+#include "lsm.h"
+
+using namespace std;
+
+int failures = 0;
+
+void check(bool ok, const string &what, const string &error = "") {
+    cout << (ok ? "[PASS] " : "[FAIL] ") << what << (error.empty() ? "" : " (" + error + ")") << "\n";
+    if (!ok) failures++;
+}
+
+// numeric counter `name` out of a store's stats_json()
+long stat_of(const KVStore &store, const string &name) {
+    string s = store.stats_json(), tag = "\"" + name + "\": ";
+    size_t at = s.find(tag);
+    return at == string::npos ? -1 : stol(s.substr(at + tag.size()));
+}
+
+// polls until stat `name` of `store` is at least 1, up to 10 s
+bool wait_for(const KVStore &store, const string &name) {
+    for (int i = 0; i < 1000; i++) {
+        if (stat_of(store, name) > 0) return true;
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    return false;
+}
+
+vector<string> list_dir(const string &dir) {
+    vector<string> names;
+    if (DIR *d = opendir(dir.c_str())) {
+        while (dirent *e = readdir(d)) names.push_back(e->d_name);
+        closedir(d);
+    }
+    return names;
+}
+
+void remove_dir(const string &dir) {
+    for (const string &n : list_dir(dir))
+        if (n != "." && n != "..") unlink((dir + "/" + n).c_str());
+    rmdir(dir.c_str());
+}
+
+// numbers of the files in `dir` ending in `suffix`
+vector<uint64_t> numbered(const string &dir, const string &suffix) {
+    vector<uint64_t> ids;
+    for (const string &n : list_dir(dir))
+        if (n.size() > suffix.size() && n.compare(n.size() - suffix.size(), suffix.size(), suffix) == 0)
+            ids.push_back(stoull(n.substr(0, n.size() - suffix.size())));
+    sort(ids.begin(), ids.end());
+    return ids;
+}
+
+// overwrites 8 bytes at `from_end` bytes before the end of a file
+bool patch_tail(const string &path, off_t from_end, uint64_t value) {
+    struct stat st;
+    int fd = open(path.c_str(), O_WRONLY);
+    bool ok = fd >= 0 && fstat(fd, &st) == 0 && pwrite(fd, &value, 8, st.st_size - from_end) == 8;
+    if (fd >= 0) close(fd);
+    return ok;
+}
+
+// drops the last `bytes` of a file: the record written last is torn
+bool cut_tail(const string &path, off_t bytes) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && st.st_size > bytes && truncate(path.c_str(), st.st_size - bytes) == 0;
+}
+
+// the workload both engines get; `expected` is what must read back (absent = deleted or torn)
+void write_workload(KVStore &store, map<string, string> &expected, int keys, const string &round) {
+    string error;
+    for (int i = 0; i < keys; i++) {
+        string key = "key" + to_string(i), value = round + string(64, 'a' + i % 26) + to_string(i);
+        store.put(key, value, error, nullptr, nullptr);
+        expected[key] = value;
+    }
+    for (int i = 0; i < keys; i += 7) {
+        string key = "key" + to_string(i);
+        store.erase(key, error);
+        expected.erase(key);
+    }
+}
+
+void verify(KVStore &store, const map<string, string> &expected, const vector<string> &absent, const string &what) {
+    string value, error;
+    long wrong = 0;
+    for (auto &kv : expected)
+        if (store.get(kv.first, value, error, nullptr) != StoreStatus::OK || value != kv.second) wrong++;
+    for (auto &key : absent)
+        if (store.get(key, value, error, nullptr) != StoreStatus::NOT_FOUND) wrong++;
+    check(wrong == 0, what + ": " + to_string(expected.size()) + " keys read back, " + to_string(wrong) + " wrong");
+}
+
+void test_bitcask(const string &root) {
+    BitcaskOptions opts;
+    opts.dir = root + "/bitcask";
+    opts.max_file_bytes = 8 << 10;
+    opts.sync_writes = false;
+    opts.merge_dead_ratio = 0.1;
+    opts.merge_min_dead_bytes = 1;
+    opts.merge_check_ms = 20;
+    map<string, string> expected;
+    string error;
+    {
+        BitcaskStore store(opts);
+        check(store.open(error), "bitcask: open a new store", error);
+        write_workload(store, expected, 400, "r1");
+        write_workload(store, expected, 400, "r2");
+        check(wait_for(store, "merges"), "bitcask: merge ran");
+        this_thread::sleep_for(chrono::milliseconds(100));   // merge thread idle again before the last writes
+        write_workload(store, expected, 10, "r3");
+        store.put("torn", string(100, 't'), error, nullptr, nullptr);
+    }
+    vector<uint64_t> data = numbered(opts.dir, ".data"), hints = numbered(opts.dir, ".hint");
+    uint64_t active = 0;
+    for (uint64_t id : data)
+        if (!binary_search(hints.begin(), hints.end(), id)) active = id;
+    check(active && active < data.back(), "bitcask: merge output ids are above the active segment " + to_string(active));
+    check(cut_tail(opts.dir + "/" + to_string(active) + ".data", 10), "bitcask: cut the last record of the active segment");
+    {
+        BitcaskStore store(opts);
+        check(store.open(error), "bitcask: reopen after the torn write", error);
+        verify(store, expected, {"torn", "key0", "key7"}, "bitcask: contents after reopen");
+    }
+    {
+        BitcaskStore store(opts);                             // clean restart of the recovered store
+        check(store.open(error), "bitcask: reopen once more", error);
+        verify(store, expected, {"torn", "key0", "key7"}, "bitcask: contents after the second reopen");
+    }
+}
+
+void test_lsm(const string &root) {
+    LSMOptions opts;
+    opts.dir = root + "/lsm";
+    opts.memtable_bytes = 16 << 10;
+    opts.table_bytes = 8 << 10;
+    opts.l0_compaction_trigger = 2;
+    opts.level1_bytes = 32 << 10;
+    opts.sync_writes = false;
+    map<string, string> expected;
+    string error;
+    {
+        LSMStore store(opts);
+        check(store.open(error), "lsm: open a new store", error);
+        write_workload(store, expected, 1000, "r1");
+        write_workload(store, expected, 1000, "r2");
+        check(wait_for(store, "compactions"), "lsm: compaction ran");
+        write_workload(store, expected, 10, "r3");               // stays in the memtable, only the WAL has it
+        store.put("torn", string(100, 't'), error, nullptr, nullptr);
+    }
+    vector<uint64_t> logs = numbered(opts.dir, ".log");
+    check(!logs.empty() && cut_tail(opts.dir + "/" + to_string(logs.back()) + ".log", 10), "lsm: cut the last record of the WAL");
+    {
+        LSMStore store(opts);
+        check(store.open(error), "lsm: reopen after the torn write", error);
+        verify(store, expected, {"torn", "key0", "key7"}, "lsm: contents after reopen");
+    }
+    {
+        LSMStore store(opts);
+        check(store.open(error), "lsm: reopen once more", error);
+        verify(store, expected, {"torn", "key0", "key7"}, "lsm: contents after the second reopen");
+    }
+    // index size in the footer (second of its 8-byte fields) far beyond the file: refused, nothing allocated
+    vector<uint64_t> tables = numbered(opts.dir, ".sst");
+    check(!tables.empty() && patch_tail(opts.dir + "/" + to_string(tables.back()) + ".sst", 48, 1ull << 60),
+          "lsm: damage a table footer");
+    {
+        LSMStore store(opts);
+        error.clear();
+        check(!store.open(error) && error.find("bad table") == 0, "lsm: open refuses the damaged table", error);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    string root = "/tmp/kv_engine_test";
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--dir=", 0) == 0) root = arg.substr(6);
+        else { cerr << "Usage: ./engine_test [--dir=<scratch directory>]\n"; return 1; }
+    }
+    remove_dir(root + "/bitcask");
+    remove_dir(root + "/lsm");
+    mkdir(root.c_str(), 0755);
+
+    test_bitcask(root);
+    test_lsm(root);
+
+    remove_dir(root + "/bitcask");
+    remove_dir(root + "/lsm");
+    rmdir(root.c_str());
+    cout << (failures ? to_string(failures) + " check(s) failed\n" : string("all checks passed\n"));
+    return failures ? 1 : 0;
+}
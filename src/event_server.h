@@ -0,0 +1,876 @@
+#pragma once
+/*=============================================================
+        epoll / io_uring front end for the key-value routes
+ ===============================================================
+ httplib gives every keep-alive connection a pool thread for as long as
+ it lives, so idle clients hold workers. Here `loops` threads each own an
+ edge-triggered epoll set and their own SO_REUSEPORT listening socket (the
+ kernel spreads new connections over them, no shared accept lock). A
+ connection is a few buffers until a complete request has arrived: the
+ HTTP/1.1 parser resumes wherever the last read() stopped, and only then
+ the request goes to the WorkerPool, which runs the same handler functions
+ the httplib server uses. The response comes back to the loop through an
+ eventfd and is written from there. Requests pipelined on one connection
+ (already complete in the read buffer behind the first) travel to the
+ worker together, up to EVENT_MAX_PIPELINE of them: the worker runs them
+ in order and their responses come back as one buffer, written with a
+ single sendmsg() instead of one wake-up and one send() per request. A
+ peer that shuts down its sending side still gets the answers to the
+ requests it sent before the connection is closed.
+
+ Responses are gathered, not assembled: status line and headers are owned
+ text, and a body a handler set as a SharedBody (every GET hit: the
+ cached value itself) is referenced where it lies and handed to the
+ kernel as its own iovec of the sendmsg(), so the value bytes are never
+ copied in user space. The reference keeps the value alive until the
+ write is done even if the cache replaces or evicts it meanwhile.
+ "zero_copy_bodies" / "zero_copy_bytes" in the stats count them.
+
+ With `uring` the loops drive the same connections through io_uring
+ instead: one multishot accept per listener, one multishot recv per
+ connection reading into buffers from a provided-buffer ring registered
+ with the kernel, sends and the eventfd read as SQEs. A loop iteration is
+ then a single io_uring_enter() that submits everything queued and waits
+ for completions, where epoll needs epoll_wait() plus a recv()/send() per
+ ready socket. Kernels without io_uring (or with it blocked) fall back to
+ epoll at start(); "syscalls_per_request" in the stats compares the two.
+
+ shard() turns the loops into shards: owner(req) names the loop a request
+ belongs to (the one whose cache slice holds its key) and a request read
+ by another loop is handed to that loop's inbox, a lock-free queue, plus
+ an eventfd wake-up. The owner first tries local(req, res), which answers
+ a cache hit right on the loop; anything it declines goes to the worker
+ pool as usual and the answer travels back to the loop holding the
+ connection through that loop's (equally lock-free) done queue. A
+ pipelined batch of hits is answered in one write. pin_loops() binds
+ loop i to the i-th CPU the process may use.
+
+ Not supported (answered with an error and the connection closed):
+ chunked request bodies (411), bodies above EVENT_MAX_BODY (413) and header
+ blocks above EVENT_MAX_HEADER (431). Streaming routes (/bulk_ingest) stay
+ on the httplib server.
+================================================================*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <regex>
+#include <functional>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "httplib.h"
+#include "worker_pool.h"
+#include "uring.h"
+#include "router.h"
+
+constexpr size_t EVENT_MAX_HEADER = 64 << 10;     // request line + headers
+constexpr size_t EVENT_MAX_BODY = 64 << 20;
+constexpr size_t EVENT_READ_BYTES = 64 << 10;     // recv() chunk
+constexpr size_t EVENT_MAX_PIPELINE = 128;        // pipelined requests handed to one worker task
+constexpr size_t EVENT_SHARED_BODY_MIN = 1024;    // smaller shared bodies are copied behind their header, one iovec
+constexpr int EVENT_WRITE_IOVECS = 64;            // pieces per sendmsg()
+constexpr unsigned EVENT_URING_ENTRIES = 4096;    // io_uring: submission queue slots per loop
+constexpr unsigned EVENT_URING_BUFFERS = 1024;    // io_uring: provided receive buffers per loop (power of two)
+constexpr unsigned EVENT_URING_BUFFER_BYTES = 16 << 10;
+
+
+// multi-producer single-consumer list: push() is one CAS, the consumer takes everything at once
+template <typename T> class MpscQueue {
+public:
+    MpscQueue() = default;
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue &operator=(const MpscQueue &) = delete;
+    ~MpscQueue() { drain([](T &) {}); }
+
+    // true if the queue was empty, i.e. the consumer needs a wake-up
+    bool push(T value) {
+        Node *n = new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+        while (!head_.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed)) {}
+        return n->next == nullptr;
+    }
+
+    // calls fn on every queued item, oldest first; consumer only
+    template <typename Fn> void drain(Fn fn) {
+        Node *n = head_.exchange(nullptr, std::memory_order_acquire), *prev = nullptr;
+        while (n) {                                  // pushed newest first: reverse
+            Node *next = n->next;
+            n->next = prev;
+            prev = n;
+            n = next;
+        }
+        while (prev) {
+            Node *next = prev->next;
+            fn(prev->value);
+            delete prev;
+            prev = next;
+        }
+    }
+
+private:
+    struct Node {
+        T value;
+        Node *next;
+    };
+    std::atomic<Node *> head_{nullptr};
+};
+
+
+/* a response body that stays where it already is (a cached value): httplib writes it to the socket straight
+   from `data` through the content provider interface, the event loops recognize it and put it in their
+   sendmsg() iovecs; set_content() would copy the value into Response::body first */
+struct SharedBody {
+    std::shared_ptr<const std::string> data;
+
+    bool operator()(size_t offset, size_t length, httplib::DataSink &sink) const {
+        return sink.write(data->data() + offset, length);
+    }
+
+    static void set(httplib::Response &res, std::shared_ptr<const std::string> data, const std::string &content_type = "text/plain") {
+        size_t n = data->size();
+        if (n) res.set_content_provider(n, content_type, SharedBody{std::move(data)});
+        else res.set_content(std::string(), content_type);
+    }
+
+    // the body of `res`, whether set_content() or set() filled it
+    static const std::string &of(const httplib::Response &res) {
+        const SharedBody *b = res.content_provider_ ? res.content_provider_.target<SharedBody>() : nullptr;
+        return b ? *b->data : res.body;
+    }
+};
+
+
+// bytes waiting for a socket: owned text (status lines, headers, small bodies) and shared bodies in place,
+// one iovec per piece; the pieces an iovec points to only move or change through append()
+class Output {
+public:
+    bool empty() const { return parts_.empty(); }
+
+    void append(const char *p, size_t n) { text().append(p, n); }
+    void append(const std::string &s) { text() += s; }
+    void append(std::shared_ptr<const std::string> body) {
+        if (body->size() < EVENT_SHARED_BODY_MIN) append(*body);
+        else parts_.push_back(Part{std::string(), std::move(body)});
+    }
+    void append(Output &&o) {
+        for (Part &p : o.parts_) {
+            if (p.shared) parts_.push_back(std::move(p));
+            else append(p.own);
+        }
+        o.clear();
+    }
+
+    // owned text is appended to, a new piece only starts behind a shared body
+    std::string &text() {
+        if (parts_.empty() || parts_.back().shared) parts_.emplace_back();
+        return parts_.back().own;
+    }
+
+    // iovecs over the bytes not written yet, at most `max`
+    int gather(iovec *iov, int max) const {
+        int n = 0;
+        for (size_t i = 0; i < parts_.size() && n < max; i++) {
+            const std::string &b = parts_[i].bytes();
+            size_t skip = i ? 0 : off_;
+            iov[n].iov_base = (void *)(b.data() + skip);
+            iov[n].iov_len = b.size() - skip;
+            n++;
+        }
+        return n;
+    }
+
+    // `n` bytes were written
+    void consume(size_t n) {
+        off_ += n;
+        while (!parts_.empty() && off_ >= parts_.front().bytes().size()) {
+            off_ -= parts_.front().bytes().size();
+            parts_.pop_front();
+        }
+    }
+
+    void clear() {
+        parts_.clear();
+        off_ = 0;
+    }
+
+private:
+    struct Part {
+        std::string own;
+        std::shared_ptr<const std::string> shared;
+        const std::string &bytes() const { return shared ? *shared : own; }
+    };
+    std::deque<Part> parts_;
+    size_t off_ = 0;                 // written bytes of parts_.front()
+};
+
+
+class EventServer {
+public:
+    EventServer(WorkerPool &pool, int loops, bool uring = false) : pool_(pool), loop_count_(std::max(1, loops)), uring_(uring) {}
+
+    ~EventServer() { stop(); }
+
+    void route(const std::string &method, const std::string &pattern, httplib::Server::Handler handler) {
+        // literal and prefix patterns go to the regex-free table, anything else keeps a regex
+        if (!router_.add(method, pattern, handler)) routes_.push_back(Route{method, std::regex(pattern), std::move(handler)});
+    }
+
+    // called for every response with status >= 400, like httplib's set_error_handler
+    void set_error_handler(httplib::Server::Handler handler) { error_handler_ = std::move(handler); }
+
+    // owner: loop index for a request (-1 = whichever loop read it), local: answers it on that loop or returns false
+    void shard(std::function<int(const httplib::Request &)> owner, std::function<bool(const httplib::Request &, httplib::Response &)> local) {
+        owner_ = std::move(owner);
+        local_ = std::move(local);
+    }
+
+    void pin_loops(bool pin) { pin_ = pin; }
+
+    // binds one listening socket per loop and starts the loops, false if the port cannot be bound
+    bool start(const std::string &host, int port) {
+        raise_fd_limit();
+        if (uring_ && !uring_supported()) {
+            std::cerr << "io_uring front end not available (" << strerror(errno) << "), using epoll\n";
+            uring_ = false;
+        }
+        for (int i = 0; i < loop_count_; i++) {
+            std::unique_ptr<Loop> loop(new Loop);
+            loop->index = i;
+            // io_uring waits on blocking descriptors itself, a non-blocking one could just fail with EAGAIN
+            loop->listen_fd = listen_socket(host, port, !uring_);
+            loop->wake_fd = eventfd(0, EFD_CLOEXEC | (uring_ ? 0 : EFD_NONBLOCK));
+            if (uring_) {
+                loop->ring.reset(new Uring);
+                if (!loop->ring->init(EVENT_URING_ENTRIES) || !loop->ring->init_buffers(EVENT_URING_BUFFERS, EVENT_URING_BUFFER_BYTES, 0))
+                    loop->ring.reset();
+            } else {
+                loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+            }
+            if (loop->listen_fd < 0 || loop->wake_fd < 0 || (uring_ ? !loop->ring : loop->epfd < 0)) {
+                std::cerr << "event front end: cannot listen on " << host << ":" << port << ": " << strerror(errno) << "\n";
+                close_loop(*loop);
+                return false;
+            }
+            if (!uring_) {
+                watch(*loop, loop->listen_fd, LISTEN_ID, EPOLLIN);   // level triggered, accept() drains it anyway
+                watch(*loop, loop->wake_fd, WAKE_ID, EPOLLIN | EPOLLET);
+            }
+            loops_.push_back(std::move(loop));
+        }
+        std::vector<int> cpus = allowed_cpus();
+        for (auto &loop : loops_) {
+            Loop *l = loop.get();
+            threads_.emplace_back([this, l] { if (uring_) run_uring(*l); else run_epoll(*l); });
+            if (pin_ && !cpus.empty()) pin_thread(threads_.back(), cpus[l->index % cpus.size()], "event loop");
+        }
+        return true;
+    }
+
+    void stop() {
+        if (stopping_.exchange(true)) return;
+        for (auto &loop : loops_) notify(*loop);
+        for (auto &t : threads_) t.join();
+        for (auto &loop : loops_) close_loop(*loop);
+    }
+
+    std::string stats_json() const {
+        std::stringstream ss;
+        long requests = requests_;
+        ss << "{\"backend\": \"" << (uring_ ? "io_uring" : "epoll") << "\", \"loops\": " << loop_count_
+           << ", \"connections\": " << open_ << ", \"accepted\": " << accepted_
+           << ", \"requests\": " << requests << ", \"pipelined\": " << pipelined_ << ", \"bad_requests\": " << bad_
+           << ", \"rejected\": " << rejected_ << ", \"handler_exceptions\": " << failed_
+           << ", \"sharded\": " << (owner_ ? "true" : "false")
+           << ", \"forwarded\": " << forwarded_ << ", \"answered_on_loop\": " << on_loop_
+           << ", \"pipeline_batches\": " << batches_ << ", \"batched_requests\": " << batched_
+           << ", \"zero_copy_bodies\": " << shared_bodies_ << ", \"zero_copy_bytes\": " << shared_bytes_ << ", \"syscalls\": " << syscalls_ << ", \"syscalls_per_request\": "
+           << std::fixed << std::setprecision(2) << (requests ? (double)syscalls_ / requests : 0.0) << "}";
+        return ss.str();
+    }
+
+    // SO_REUSEPORT listening socket on host:port, -1 on failure (also used by the RESP listener)
+    static int listen_socket(const std::string &host, int port, bool nonblock) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | (nonblock ? SOCK_NONBLOCK : 0), 0);
+        if (fd < 0) return -1;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));   // one accept queue per loop
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+            bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // idle connections are file descriptors: lift the soft limit to the hard one
+    static void raise_fd_limit() {
+        rlimit lim;
+        if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+            lim.rlim_cur = lim.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &lim);
+        }
+    }
+
+private:
+    static constexpr uint64_t LISTEN_ID = 0, WAKE_ID = 1;
+    enum UringOp : uint64_t { OP_ACCEPT, OP_WAKE, OP_RECV, OP_SEND };   // low bits of an SQE's user_data
+
+    struct Route {
+        std::string method;
+        std::regex pattern;
+        httplib::Server::Handler handler;
+    };
+
+    struct Conn {
+        int fd = -1;
+        std::string in;              // bytes read and not yet consumed by a request
+        size_t scanned = 0;          // in[0..scanned) holds no "\r\n\r\n", the header search resumes here
+        size_t header_bytes = 0;     // 0 until the header block is complete
+        bool continue_sent = false;  // "100 Continue" answered for the current request
+        Output out;                  // response bytes not written yet
+        bool busy = false;           // a request of this connection is with a worker
+        bool close_after = false;    // close once `out` is written
+        bool read_closed = false;    // peer sent FIN: the buffered requests are still answered
+        // io_uring only: `sending` and the iovecs over it must stay put until its SENDMSG completes,
+        // new responses queue up in `out`
+        Output sending;
+        iovec iov[EVENT_WRITE_IOVECS];
+        msghdr msg;
+        bool send_inflight = false, recv_armed = false;
+        bool closing = false;        // shut down, kept until the kernel has finished with its buffers
+    };
+
+    struct Done {
+        uint64_t id;
+        Output response;
+        bool close;
+    };
+
+    struct Forward {
+        std::shared_ptr<httplib::Request> req;
+        int origin;                  // loop holding the connection
+        uint64_t id;
+    };
+
+    struct Loop {
+        int index = 0;
+        int epfd = -1, listen_fd = -1, wake_fd = -1;
+        std::unique_ptr<Uring> ring;                        // io_uring backend instead of epfd
+        uint64_t wake_value = 0;                            // io_uring: target of the eventfd read
+        std::unordered_map<uint64_t, std::unique_ptr<Conn>> conns;   // only touched by the loop thread
+        uint64_t next_id = 2;
+        MpscQueue<Done> done;                               // answers from the workers and the other loops
+        MpscQueue<Forward> inbox;                           // requests for this shard read by the other loops
+    };
+
+    void run_epoll(Loop &loop) {
+        epoll_event events[256];
+        while (!stopping_) {
+            int n = epoll_wait(loop.epfd, events, 256, 1000);
+            syscalls_++;
+            for (int i = 0; i < n; i++) {
+                uint64_t id = events[i].data.u64;
+                if (id == LISTEN_ID) accept_all(loop);
+                else if (id == WAKE_ID) finish(loop);
+                else io(loop, id, events[i].events);
+            }
+        }
+    }
+
+    void accept_all(Loop &loop) {
+        while (true) {
+            int fd = accept4(loop.listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            syscalls_++;
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EMFILE || errno == ENFILE) std::cerr << "epoll front end: out of file descriptors\n";
+                return;                                     // EAGAIN: drained
+            }
+            uint64_t id = add_conn(loop, fd);
+            watch(loop, fd, id, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+            syscalls_++;
+        }
+    }
+
+    uint64_t add_conn(Loop &loop, int fd) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        syscalls_++;
+        uint64_t id = loop.next_id++;
+        std::unique_ptr<Conn> c(new Conn);
+        c->fd = fd;
+        loop.conns.emplace(id, std::move(c));
+        accepted_++;
+        open_++;
+        return id;
+    }
+
+    void run_uring(Loop &loop) {
+        Uring &ring = *loop.ring;
+        ring.accept_multishot(loop.listen_fd, tag(LISTEN_ID, OP_ACCEPT));
+        ring.read(loop.wake_fd, &loop.wake_value, sizeof(loop.wake_value), tag(WAKE_ID, OP_WAKE));
+        long enters = 0;
+        while (!stopping_) {
+            if (ring.submit_and_wait() < 0) { std::cerr << "io_uring_enter failed: " << strerror(errno) << "\n"; return; }
+            syscalls_ += ring.enters() - enters;
+            enters = ring.enters();
+            ring.for_each_completion([&](const io_uring_cqe &cqe) { complete(loop, cqe); });
+        }
+    }
+
+    static uint64_t tag(uint64_t id, UringOp op) { return id << 2 | op; }
+
+    // one io_uring completion
+    void complete(Loop &loop, const io_uring_cqe &cqe) {
+        Uring &ring = *loop.ring;
+        uint64_t id = cqe.user_data >> 2;
+        bool more = cqe.flags & IORING_CQE_F_MORE;           // multishot op still armed
+        switch ((UringOp)(cqe.user_data & 3)) {
+        case OP_ACCEPT:
+            if (cqe.res >= 0) {
+                uint64_t conn = add_conn(loop, cqe.res);
+                ring.recv_multishot(cqe.res, tag(conn, OP_RECV));
+                loop.conns[conn]->recv_armed = true;
+            } else if (cqe.res == -EMFILE || cqe.res == -ENFILE) {
+                std::cerr << "io_uring front end: out of file descriptors\n";
+            }
+            if (!more && !stopping_) ring.accept_multishot(loop.listen_fd, tag(LISTEN_ID, OP_ACCEPT));
+            return;
+        case OP_WAKE:
+            finish(loop);
+            ring.read(loop.wake_fd, &loop.wake_value, sizeof(loop.wake_value), tag(WAKE_ID, OP_WAKE));
+            return;
+        case OP_RECV: {
+            auto it = loop.conns.find(id);
+            Conn *c = it == loop.conns.end() ? nullptr : it->second.get();
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                unsigned bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+                if (c && !c->closing && cqe.res > 0) c->in.append(ring.buffer(bid), cqe.res);
+                ring.recycle(bid);
+            }
+            if (!c) return;
+            if (!more) c->recv_armed = false;
+            if (c->closing) { close_conn(loop, id); return; }
+            if (cqe.res == -ENOBUFS || (cqe.res > 0 && !more)) {   // out of buffers for a moment: arm again
+                ring.recv_multishot(c->fd, tag(id, OP_RECV));
+                c->recv_armed = true;
+            } else if (cqe.res == 0) {
+                c->read_closed = true;                       // half-close, process() closes once all is answered
+            } else if (cqe.res < 0) {
+                close_conn(loop, id);                        // reset, an answer in flight is dropped
+                return;
+            }
+            process(loop, id, *c);
+            return;
+        }
+        case OP_SEND: {
+            auto it = loop.conns.find(id);
+            if (it == loop.conns.end()) return;
+            Conn &c = *it->second;
+            c.send_inflight = false;
+            if (c.closing || cqe.res < 0) { close_conn(loop, id); return; }
+            c.sending.consume(cqe.res);
+            process(loop, id, c);
+            return;
+        }
+        }
+    }
+
+    void io(Loop &loop, uint64_t id, uint32_t events) {
+        auto it = loop.conns.find(id);
+        if (it == loop.conns.end()) return;                 // closed earlier in this batch
+        Conn &c = *it->second;
+        if (events & EPOLLERR) { close_conn(loop, id); return; }
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+            // edge triggered: read until the socket is empty
+            static thread_local char buf[EVENT_READ_BYTES];
+            while (true) {
+                ssize_t r = recv(c.fd, buf, sizeof(buf), 0);
+                syscalls_++;
+                if (r > 0) { c.in.append(buf, r); continue; }
+                if (r < 0 && errno == EINTR) continue;
+                if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                if (r == 0) { c.read_closed = true; break; }   // half-close, process() closes once all is answered
+                close_conn(loop, id);                       // reset, an answer in flight is dropped
+                return;
+            }
+        }
+        process(loop, id, c);                               // also writes what EPOLLOUT has room for
+    }
+
+    /* runs the complete requests in c.in until one has to wait: errors and requests local() answers are
+       handled right here, the rest goes to the owning loop or a worker; then writes what is ready */
+    void process(Loop &loop, uint64_t id, Conn &c) {
+        if (c.closing) return;
+        while (!c.busy && !c.close_after) {
+            httplib::Request req;
+            int status = parse(c, req);
+            if (status == 0) {                              // incomplete, wait for more bytes...
+                c.close_after = c.read_closed;              // ...unless none will come: close once `out` is written
+                break;
+            }
+            if (status != 200) {
+                bad_++;
+                httplib::Response res;
+                res.status = status;
+                answer(req, res, true, c.out);
+                c.close_after = true;
+                break;
+            }
+            requests_++;
+            if (!c.in.empty()) pipelined_++;
+            auto shared_req = std::make_shared<httplib::Request>(std::move(req));
+            int owner = owner_ ? owner_(*shared_req) : -1;
+            if (owner >= 0 && owner < loop_count_ && owner != loop.index) {
+                forwarded_++;
+                c.busy = true;
+                if (loops_[owner]->inbox.push(Forward{shared_req, loop.index, id})) notify(*loops_[owner]);
+                break;
+            }
+            httplib::Response res;
+            if (local_ && local_(*shared_req, res)) {
+                on_loop_++;
+                bool close = wants_close(*shared_req);
+                if (res.status == -1) res.status = 200;
+                answer(*shared_req, res, close, c.out);
+                c.close_after = close;
+                continue;                                   // next pipelined request, answered in the same write
+            }
+            c.busy = true;
+            std::vector<std::shared_ptr<httplib::Request>> batch{shared_req};
+            // complete requests pipelined behind it ride along: one worker task, one write for all the responses
+            while (batch.size() < EVENT_MAX_PIPELINE && !wants_close(*batch.back())) {
+                httplib::Request more;
+                if (parse(c, more, false) != 200) break;   // incomplete or malformed: the next round deals with it
+                requests_++;
+                if (!c.in.empty()) pipelined_++;
+                batch.push_back(std::make_shared<httplib::Request>(std::move(more)));
+            }
+            to_worker(loop.index, id, std::move(batch));
+        }
+        flush(loop, id, c);                                 // "100 Continue" included
+    }
+
+    // runs the requests in order on the pool, their answers go to loop `origin` together; a full pool answers 503,
+    // a handler that throws 500
+    void to_worker(int origin, uint64_t id, std::vector<std::shared_ptr<httplib::Request>> batch) {
+        if (batch.size() > 1) {
+            batches_++;
+            batched_ += batch.size();
+        }
+        auto reqs = std::make_shared<std::vector<std::shared_ptr<httplib::Request>>>(std::move(batch));
+        bool queued = pool_.enqueue([this, origin, id, reqs] {
+            Output out;
+            bool close = false;
+            for (auto &req : *reqs) {                       // only the last one can ask for close
+                httplib::Response res;
+                try {
+                    dispatch(*req, res);
+                } catch (...) {                             // as httplib does: 500, and the connection lives on
+                    failed_++;
+                    res = httplib::Response();
+                    res.status = 500;
+                    if (error_handler_) error_handler_(*req, res);
+                }
+                close = wants_close(*req);
+                serialize(*req, res, close, out);
+            }
+            post(origin, Done{id, std::move(out), close});
+        });
+        if (!queued) {
+            rejected_++;
+            httplib::Response res;
+            res.status = 503;
+            res.set_header("Retry-After", "1");
+            Output out;
+            answer(*reqs->front(), res, true, out);
+            post(origin, Done{id, std::move(out), true});
+        }
+    }
+
+    void post(int origin, Done done) {
+        if (loops_[origin]->done.push(std::move(done))) notify(*loops_[origin]);   // one wake-up per batch of answers
+    }
+
+    // requests forwarded to this shard, then answers produced since the last wake-up
+    void finish(Loop &loop) {
+        uint64_t n;
+        while (!uring_ && read(loop.wake_fd, &n, sizeof(n)) > 0) syscalls_++;   // io_uring already read it
+        loop.inbox.drain([&](Forward &f) {
+            httplib::Response res;
+            if (local_ && local_(*f.req, res)) {
+                on_loop_++;
+                bool close = wants_close(*f.req);
+                if (res.status == -1) res.status = 200;
+                Output out;
+                answer(*f.req, res, close, out);
+                post(f.origin, Done{f.id, std::move(out), close});
+            } else {
+                to_worker(f.origin, f.id, {f.req});
+            }
+        });
+        loop.done.drain([&](Done &d) {
+            auto it = loop.conns.find(d.id);
+            if (it == loop.conns.end() || it->second->closing) return;   // client went away meanwhile
+            Conn &c = *it->second;
+            c.busy = false;
+            c.close_after = c.close_after || d.close;
+            c.out.append(std::move(d.response));
+            process(loop, d.id, c);
+        });
+    }
+
+    // serialized answer appended to `out`, with the error handler applied as dispatch() does for handler results
+    void answer(const httplib::Request &req, httplib::Response &res, bool close, Output &out) {
+        if (error_handler_ && res.status >= 400) error_handler_(req, res);
+        serialize(req, res, close, out);
+    }
+
+    // writes what the socket takes; false if the connection was closed
+    bool flush(Loop &loop, uint64_t id, Conn &c) {
+        if (uring_) {
+            if (c.send_inflight) return true;               // its completion calls flush() again
+            c.sending.append(std::move(c.out));
+            if (!c.sending.empty()) {
+                c.msg = msghdr{};
+                c.msg.msg_iov = c.iov;
+                c.msg.msg_iovlen = c.sending.gather(c.iov, EVENT_WRITE_IOVECS);
+                loop.ring->sendmsg(c.fd, &c.msg, tag(id, OP_SEND));
+                c.send_inflight = true;
+                return true;
+            }
+            if (c.close_after && !c.busy) { close_conn(loop, id); return false; }
+            return true;
+        }
+        // sendmsg() rather than writev(): same gather write, and MSG_NOSIGNAL instead of SIGPIPE
+        while (!c.out.empty()) {
+            iovec iov[EVENT_WRITE_IOVECS];
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = c.out.gather(iov, EVENT_WRITE_IOVECS);
+            ssize_t w = sendmsg(c.fd, &msg, MSG_NOSIGNAL);
+            syscalls_++;
+            if (w > 0) { c.out.consume(w); continue; }
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;   // EPOLLOUT resumes it
+            close_conn(loop, id);
+            return false;
+        }
+        if (c.close_after && !c.busy) { close_conn(loop, id); return false; }
+        return true;
+    }
+
+    /* incremental HTTP/1.1 request parser over c.in
+       returns 0 = need more bytes, 200 = `req` complete (consumed from c.in), else the error status to answer;
+       `interim` false holds back "100 Continue" (earlier responses of the connection are still outstanding) */
+    int parse(Conn &c, httplib::Request &req, bool interim = true) {
+        if (!c.header_bytes) {
+            size_t from = c.scanned >= 3 ? c.scanned - 3 : 0;   // the terminator may straddle two reads
+            size_t end = c.in.find("\r\n\r\n", from);
+            if (end == std::string::npos) {
+                c.scanned = c.in.size();
+                return c.in.size() > EVENT_MAX_HEADER ? 431 : 0;
+            }
+            c.header_bytes = end + 4;
+            if (c.header_bytes > EVENT_MAX_HEADER) return 431;
+        }
+        // headers are parsed again once the body is complete, cheaper than keeping a half built Request around
+        if (!parse_head(c.in.data(), c.header_bytes, req)) return 400;
+        if (req.has_header("Transfer-Encoding")) return 411;
+        const std::string length = req.get_header_value("Content-Length");
+        size_t body = 0;
+        if (!length.empty()) {
+            char *end = nullptr;
+            unsigned long long v = strtoull(length.c_str(), &end, 10);
+            if (*end || length[0] == '-') return 400;
+            if (v > EVENT_MAX_BODY) return 413;
+            body = v;
+        }
+        if (c.in.size() < c.header_bytes + body) {
+            if (interim && !c.continue_sent && req.get_header_value("Expect") == "100-continue") {
+                c.out.append("HTTP/1.1 100 Continue\r\n\r\n");
+                c.continue_sent = true;
+            }
+            return 0;
+        }
+        req.body.assign(c.in, c.header_bytes, body);
+        c.in.erase(0, c.header_bytes + body);
+        c.header_bytes = c.scanned = 0;
+        c.continue_sent = false;
+        return 200;
+    }
+
+    // request line and header fields, path percent-decoded and query split off as httplib does
+    static bool parse_head(const char *p, size_t n, httplib::Request &req) {
+        const char *end = p + n - 2, *eol = (const char *)memchr(p, '\r', n);
+        const char *sp1 = (const char *)memchr(p, ' ', eol - p);
+        if (!sp1) return false;
+        const char *sp2 = (const char *)memchr(sp1 + 1, ' ', eol - sp1 - 1);
+        if (!sp2) return false;
+        req.method.assign(p, sp1);
+        req.target.assign(sp1 + 1, sp2);
+        req.version.assign(sp2 + 1, eol);
+        if (req.version != "HTTP/1.1" && req.version != "HTTP/1.0") return false;
+        size_t q = req.target.find('?');
+        req.path = httplib::decode_path_component(req.target.substr(0, q));
+        if (q != std::string::npos) httplib::detail::parse_query_text(req.target.substr(q + 1), req.params);
+        for (const char *line = eol + 2; line < end;) {
+            const char *nl = (const char *)memchr(line, '\r', end - line + 2);
+            const char *colon = (const char *)memchr(line, ':', nl - line);
+            if (!colon || colon == line) return false;
+            const char *v = colon + 1;
+            while (v < nl && (*v == ' ' || *v == '\t')) v++;
+            const char *ve = nl;
+            while (ve > v && (ve[-1] == ' ' || ve[-1] == '\t')) ve--;
+            req.headers.emplace(std::string(line, colon), std::string(v, ve));
+            line = nl + 2;
+        }
+        return true;
+    }
+
+    void dispatch(httplib::Request &req, httplib::Response &res) {
+        if (const Router::Handler *h = router_.find(req.method, req.path)) {
+            (*h)(req, res);
+            if (res.status == -1) res.status = 200;
+            if (error_handler_ && res.status >= 400) error_handler_(req, res);
+            return;
+        }
+        for (const Route &r : routes_) {
+            if (r.method != req.method || !std::regex_match(req.path, req.matches, r.pattern)) continue;
+            r.handler(req, res);
+            if (res.status == -1) res.status = 200;
+            if (error_handler_ && res.status >= 400) error_handler_(req, res);
+            return;
+        }
+        res.status = 404;
+        if (error_handler_) error_handler_(req, res);
+    }
+
+    static bool wants_close(const httplib::Request &req) {
+        const std::string conn = req.get_header_value("Connection");
+        if (req.version == "HTTP/1.0") return conn != "keep-alive" && conn != "Keep-Alive";
+        return conn == "close";
+    }
+
+    /* status line and headers into the owned text of `out`, the body behind them: copied from res.body, or
+       referenced in place when it is a SharedBody of EVENT_SHARED_BODY_MIN bytes or more (a cached value goes
+       to the socket from the cache's own buffer). A plain 200 text/plain answer, every GET hit, starts from a
+       prebuilt header block */
+    void serialize(const httplib::Request &req, const httplib::Response &res, bool close, Output &out) {
+        static const std::string ok_text = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: ";
+        const SharedBody *shared = res.content_provider_ ? res.content_provider_.target<SharedBody>() : nullptr;
+        const std::string &body = shared ? *shared->data : res.body;
+        std::string &head = out.text();
+        if (res.status == 200 && res.headers.size() == 1 && res.get_header_value("Content-Type") == "text/plain") {
+            head += ok_text;
+        } else {
+            head += "HTTP/1.1 ";
+            head += std::to_string(res.status);
+            head += ' ';
+            head += httplib::status_message(res.status);
+            head += "\r\n";
+            for (auto &h : res.headers) {
+                if (h.first == "Content-Length" || h.first == "Connection") continue;
+                head += h.first;
+                head += ": ";
+                head += h.second;
+                head += "\r\n";
+            }
+            head += "Content-Length: ";
+        }
+        head += std::to_string(body.size());
+        head += close ? "\r\nConnection: close\r\n\r\n" : "\r\n\r\n";
+        if (req.method == "HEAD") return;
+        if (!shared) { head += body; return; }
+        if (body.size() >= EVENT_SHARED_BODY_MIN) {
+            shared_bodies_++;
+            shared_bytes_ += body.size();
+        }
+        out.append(shared->data);
+    }
+
+    static void watch(Loop &loop, int fd, uint64_t id, uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = id;
+        epoll_ctl(loop.epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void notify(Loop &loop) {
+        uint64_t one = 1;
+        syscalls_++;
+        if (write(loop.wake_fd, &one, sizeof(one)) < 0) {}  // a full counter still wakes the loop
+    }
+
+    // io_uring: shuts the socket down (ends the multishot recv) and frees it once no op refers to it
+    void close_conn(Loop &loop, uint64_t id) {
+        auto it = loop.conns.find(id);
+        if (it == loop.conns.end()) return;
+        Conn &c = *it->second;
+        if (!c.closing) {
+            c.closing = true;
+            open_--;
+            if (uring_) { shutdown(c.fd, SHUT_RDWR); syscalls_++; }
+        }
+        if (c.recv_armed || c.send_inflight) return;
+        close(c.fd);                                        // also removes it from the epoll set
+        syscalls_++;
+        loop.conns.erase(it);
+    }
+
+    // io_uring_setup works and the kernel has multishot recv (6.0)
+    static bool uring_supported() {
+        utsname u;
+        int major = 0, minor = 0;
+        if (uname(&u) != 0 || sscanf(u.release, "%d.%d", &major, &minor) != 2 || major < 6) { errno = ENOSYS; return false; }
+        Uring probe;
+        return probe.init(8) && probe.init_buffers(8, 4096, 0);
+    }
+
+    void close_loop(Loop &loop) {
+        for (auto &c : loop.conns) close(c.second->fd);
+        loop.conns.clear();
+        loop.ring.reset();
+        for (int fd : {loop.listen_fd, loop.epfd, loop.wake_fd})
+            if (fd >= 0) close(fd);
+        loop.listen_fd = loop.epfd = loop.wake_fd = -1;
+    }
+
+    WorkerPool &pool_;
+    const int loop_count_;
+    Router router_;                          // fixed before start()
+    std::vector<Route> routes_;              // patterns the router does not take
+    httplib::Server::Handler error_handler_;
+    std::function<int(const httplib::Request &)> owner_;                        // shard(), fixed before start()
+    std::function<bool(const httplib::Request &, httplib::Response &)> local_;
+    bool pin_ = false;
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> stopping_{false};
+    bool uring_;
+    std::atomic<long> open_{0}, accepted_{0}, requests_{0}, pipelined_{0}, bad_{0}, rejected_{0}, failed_{0};
+    std::atomic<long> forwarded_{0}, on_loop_{0};  // shards: requests handed to their owning loop / answered by local()
+    std::atomic<long> batches_{0}, batched_{0};    // worker tasks carrying several pipelined requests, and those requests
+    std::atomic<long> shared_bodies_{0}, shared_bytes_{0};   // bodies written from the cache's buffers, not copied
+    std::atomic<long> syscalls_{0};          // made by the loops and the workers' wake-ups, for comparing backends
+};
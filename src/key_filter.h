@@ -0,0 +1,85 @@
+#pragma once
+/*=============================================================
+          Counting bloom filter over the stored keys
+ ===============================================================
+ Built at startup by streaming every key out of the store, then kept in
+ sync by PUT (new keys only) and DELETE. A GET miss consults it before the
+ store: "definitely absent" is answered with 404 without a DB round trip.
+
+ Each slot is an 8-bit counter instead of a bit so keys can be removed.
+ A counter that reaches 255 sticks there (it can no longer be decremented
+ safely), which only ever costs false positives, never false negatives.
+================================================================*/
+#include <atomic>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include "kv_store.h"
+
+class CountingBloomFilter {
+public:
+    CountingBloomFilter(uint64_t expected_keys, int bits_per_key = 10)
+        : size_(std::max<uint64_t>(1024, expected_keys * bits_per_key)),
+          hashes_(std::min(16, std::max(1, (int)std::lround(bits_per_key * 0.69)))),   // ln 2 * counters/key
+          counters_(new std::atomic<uint8_t>[size_]) {
+        for (uint64_t i = 0; i < size_; i++) counters_[i].store(0, std::memory_order_relaxed);
+    }
+
+    void add(const std::string &key) {
+        uint64_t h = hash64(key.data(), key.size()), delta = (h >> 33) | (h << 31);
+        for (int i = 0; i < hashes_; i++, h += delta) {
+            auto &c = counters_[h % size_];
+            uint8_t v = c.load(std::memory_order_relaxed);
+            while (v < MAX && !c.compare_exchange_weak(v, v + 1, std::memory_order_relaxed)) {}
+            if (v + 1 == MAX) saturated_++;
+        }
+        keys_++;
+    }
+
+    void remove(const std::string &key) {
+        uint64_t h = hash64(key.data(), key.size()), delta = (h >> 33) | (h << 31);
+        for (int i = 0; i < hashes_; i++, h += delta) {
+            auto &c = counters_[h % size_];
+            uint8_t v = c.load(std::memory_order_relaxed);
+            while (v > 0 && v < MAX && !c.compare_exchange_weak(v, v - 1, std::memory_order_relaxed)) {}
+        }
+        keys_--;
+    }
+
+    // false → the key is definitely not stored
+    bool may_contain(const std::string &key) {
+        checks_++;
+        uint64_t h = hash64(key.data(), key.size()), delta = (h >> 33) | (h << 31);
+        for (int i = 0; i < hashes_; i++, h += delta)
+            if (counters_[h % size_].load(std::memory_order_relaxed) == 0) { negatives_++; return false; }
+        return true;
+    }
+
+    // the filter said "maybe" but the store did not have the key
+    void record_false_positive() { false_positives_++; }
+
+    std::string stats_json() const {
+        long fp = false_positives_, tn = negatives_;
+        double n = std::max<long>(0, keys_);
+        double estimated = std::pow(1.0 - std::exp(-hashes_ * n / (double)size_), hashes_);   // (1 - e^(-kn/m))^k
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(4);
+        ss << "{\"keys\": " << keys_ << ", \"counters\": " << size_ << ", \"hashes\": " << hashes_
+           << ", \"checks\": " << checks_ << ", \"negatives\": " << tn << ", \"false_positives\": " << fp
+           << ", \"observed_fp_rate\": " << (fp + tn ? (double)fp / (fp + tn) : 0.0)
+           << ", \"estimated_fp_rate\": " << estimated
+           << ", \"saturated_counters\": " << saturated_ << "}";
+        return ss.str();
+    }
+
+private:
+    static constexpr uint8_t MAX = 255;
+
+    const uint64_t size_;                          // number of counters
+    const int hashes_;                             // probes per key (double hashing)
+    std::unique_ptr<std::atomic<uint8_t>[]> counters_;
+    std::atomic<long> keys_{0}, checks_{0}, negatives_{0}, false_positives_{0}, saturated_{0};
+};
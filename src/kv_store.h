@@ -0,0 +1,177 @@
+#pragma once
+/*=============================================================
+            Storage tier interface used by the server
+ ===============================================================
+ The HTTP handlers in server.cpp only talk to this interface, so the
+ persistent tier can be MySQL (mysql_store.h) or one of the embedded
+ engines (bitcask.h) selected with --backend on the command line.
+================================================================*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+enum class StoreStatus { OK, NOT_FOUND, ERROR };
+
+// one key of a get_many() lookup
+struct KVRead {
+    bool found = false;
+    std::string value;
+    uint64_t version = 0;
+};
+
+// one key of an erase_many()
+enum class EraseResult { DELETED, ABSENT };
+
+class KVStore {
+public:
+    virtual ~KVStore() = default;
+
+    virtual const char *name() const = 0;   // backend name reported in /stats
+
+    // every call returns OK / NOT_FOUND / ERROR, on ERROR `error` holds a readable message
+    // `version` (optional) receives the version of the value read or written, it grows with every write
+    // of a key so the cache can tell which of two racing values is the newer one
+    virtual StoreStatus get(const std::string &key, std::string &value, std::string &error, uint64_t *version) = 0;
+    // `created` (optional) is set to true when the key did not exist before
+    virtual StoreStatus put(const std::string &key, const std::string &value, std::string &error, bool *created, uint64_t *version) = 0;
+    virtual StoreStatus erase(const std::string &key, std::string &error) = 0;   // NOT_FOUND if nothing was deleted
+
+    // write a batch of pairs (bulk ingest), backends override it with something cheaper than one put() per pair
+    virtual StoreStatus put_many(const std::vector<std::pair<std::string, std::string>> &kvs, std::string &error) {
+        for (const auto &kv : kvs)
+            if (put(kv.first, kv.second, error, nullptr, nullptr) == StoreStatus::ERROR) return StoreStatus::ERROR;
+        return StoreStatus::OK;
+    }
+
+    // look up several keys at once (prefetching), out[i] answers keys[i]; backends with a cheaper
+    // multi-key read override the default of one get() per key
+    virtual StoreStatus get_many(const std::vector<std::string> &keys, std::vector<KVRead> &out, std::string &error) {
+        out.assign(keys.size(), KVRead());
+        for (size_t i = 0; i < keys.size(); i++) {
+            StoreStatus st = get(keys[i], out[i].value, error, &out[i].version);
+            if (st == StoreStatus::ERROR) return st;
+            out[i].found = (st == StoreStatus::OK);
+        }
+        return StoreStatus::OK;
+    }
+
+    // delete several keys at once (MDELETE), out[i] answers keys[i]; a key listed twice is DELETED at most once
+    virtual StoreStatus erase_many(const std::vector<std::string> &keys, std::vector<EraseResult> &out, std::string &error) {
+        out.assign(keys.size(), EraseResult::ABSENT);
+        for (size_t i = 0; i < keys.size(); i++) {
+            StoreStatus st = erase(keys[i], error);
+            if (st == StoreStatus::ERROR) return st;
+            if (st == StoreStatus::OK) out[i] = EraseResult::DELETED;
+        }
+        return StoreStatus::OK;
+    }
+
+    // stream every stored key (used to build the server's key filter at startup), false if unsupported
+    virtual bool scan_keys(const std::function<void(const std::string &)> &, std::string &error) {
+        error = std::string(name()) + " does not support key scans";
+        return false;
+    }
+    virtual uint64_t estimated_keys() { return 0; }   // cheap row count estimate for sizing, 0 if unknown
+    virtual bool ping() { return true; }              // health probe used while the circuit breaker is open
+
+    // backend specific statistics as a JSON object, appended to /stats
+    virtual std::string stats_json() const { return "{}"; }
+};
+
+
+// CRC-32 (IEEE polynomial, same as zlib) used by the on-disk formats for record checksums
+inline uint32_t crc32(const void *data, size_t len, uint32_t crc = 0) {
+    static const struct Table {
+        uint32_t t[256];
+        Table() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+        }
+    } table;
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) crc = table.t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+// stable 64-bit hash of a byte string (FNV-1a followed by the murmur3 finalizer),
+// unlike std::hash it is the same in every build so it can be persisted in files
+inline uint64_t hash64(const void *data, size_t len) {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < len; i++) { h ^= p[i]; h *= 1099511628211ull; }
+    h ^= h >> 33; h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+
+
+/*-------------- file helpers shared by the embedded engines --------------*/
+inline bool pread_all(int fd, char *buf, size_t len, uint64_t off) {
+    while (len > 0) {
+        ssize_t n = ::pread(fd, buf, len, off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n; len -= n; off += n;
+    }
+    return true;
+}
+
+inline bool pwrite_all(int fd, const char *buf, size_t len, uint64_t off) {
+    while (len > 0) {
+        ssize_t n = ::pwrite(fd, buf, len, off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buf += n; len -= n; off += n;
+    }
+    return true;
+}
+
+// whole file into `out`
+inline bool read_file(int fd, std::string &out) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0) return false;
+    out.resize(st.st_size);
+    return st.st_size == 0 || pread_all(fd, &out[0], out.size(), 0);
+}
+
+// create (or truncate) `path` with `content` and make it durable
+inline bool write_new_file(const std::string &path, const std::string &content) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool ok = pwrite_all(fd, content.data(), content.size(), 0) && ::fdatasync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+// mkdir -p
+inline bool make_dirs(const std::string &dir) {
+    for (size_t i = 1; i <= dir.size(); i++) {
+        if (i < dir.size() && dir[i] != '/') continue;
+        if (::mkdir(dir.substr(0, i).c_str(), 0755) != 0 && errno != EEXIST) return false;
+    }
+    return true;
+}
+
+// persist renames / creations inside `dir`
+inline void fsync_dir(const std::string &dir) {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) { ::fsync(fd); ::close(fd); }
+}
+
+inline bool ends_with(const std::string &s, const char *suffix) {
+    size_t n = std::char_traits<char>::length(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
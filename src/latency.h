@@ -0,0 +1,78 @@
+#pragma once
+/*=============================================================
+                Lock-free latency histogram
+ ===============================================================
+ Log-linear buckets over microseconds: exact below 16us, then four buckets
+ per power of two (at most ~19% wide), so percentiles are cheap to read
+ and recording is a couple of relaxed atomic increments.
+================================================================*/
+#include <atomic>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cstdint>
+
+class LatencyHistogram {
+public:
+    void record(std::chrono::steady_clock::duration d) {
+        record_us(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+
+    void record_us(uint64_t us) {
+        buckets_[bucket(us)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_us_.fetch_add(us, std::memory_order_relaxed);
+        uint64_t prev = max_us_.load(std::memory_order_relaxed);
+        while (us > prev && !max_us_.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+    }
+
+    long count() const { return count_.load(std::memory_order_relaxed); }
+
+    // start over (samples recorded concurrently may be half counted, fine for a moving estimate)
+    void reset() {
+        for (auto &b : buckets_) b.store(0, std::memory_order_relaxed);
+        count_ = 0;
+        sum_us_ = 0;
+        max_us_ = 0;
+    }
+
+    // upper bound of the bucket holding the q-quantile (0 < q <= 1), 0 without samples
+    uint64_t percentile_us(double q) const {
+        uint64_t total = count_.load(std::memory_order_relaxed);
+        if (!total) return 0;
+        uint64_t want = std::max<uint64_t>(1, (uint64_t)(q * total + 0.5)), seen = 0;
+        for (int i = 0; i < BUCKETS; i++) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= want) return std::min(upper(i), max_us_.load(std::memory_order_relaxed));
+        }
+        return max_us_.load(std::memory_order_relaxed);
+    }
+
+    std::string stats_json() const {
+        long n = count();
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        ss << "{\"requests\": " << n << ", \"avg_us\": " << (n ? (double)sum_us_ / n : 0.0)
+           << ", \"p50_us\": " << percentile_us(0.5) << ", \"p99_us\": " << percentile_us(0.99)
+           << ", \"p999_us\": " << percentile_us(0.999) << ", \"max_us\": " << max_us_ << "}";
+        return ss.str();
+    }
+
+private:
+    static constexpr int BUCKETS = 16 + 60 * 4;
+
+    static int bucket(uint64_t us) {
+        if (us < 16) return (int)us;
+        int e = 63 - __builtin_clzll(us);                 // 4 .. 63
+        return 16 + (e - 4) * 4 + (int)((us >> (e - 2)) & 3);
+    }
+    static uint64_t upper(int i) {
+        if (i < 16) return i;
+        int e = (i - 16) / 4 + 4, sub = (i - 16) % 4;
+        return ((uint64_t)(4 + sub + 1) << (e - 2)) - 1;
+    }
+
+    std::atomic<uint64_t> buckets_[BUCKETS] = {};
+    std::atomic<uint64_t> count_{0}, sum_us_{0}, max_us_{0};
+};
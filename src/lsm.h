@@ -0,0 +1,925 @@
+#pragma once
+/*=============================================================
+              Embedded LSM-tree storage engine
+ ===============================================================
+ Selectable backend for write-heavy mixes and data larger than RAM
+ (--backend=lsm).
+
+ - memtable  lock-free-read skiplist ordered by (key asc, seq desc), one writer
+ - WAL       <num>.log, every write is appended before it enters the memtable,
+             concurrent writers share one fdatasync (group commit)
+ - SSTable   <num>.sst immutable sorted file:
+               data blocks (~4 KB, crc per block) | index block | bloom filter | meta | footer
+ - levels    L0 holds flushed memtables (may overlap, newest first),
+             L1..Ln are sorted runs whose size limit grows 10x per level
+ - compaction one background thread flushes the immutable memtable and runs
+             leveled compaction (L0 → L1 when L0 has enough files, Li → Li+1
+             when a level is over its size limit), dropping shadowed versions
+             and tombstones that reached the bottom
+ - MANIFEST  text file naming the live tables per level, rewritten atomically
+
+ Read amplification, write amplification and compaction counters are
+ reported through stats_json() and show up in /stats.
+================================================================*/
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include "kv_store.h"
+
+struct LSMOptions {
+    std::string dir = "data/lsm";              // WAL, tables and MANIFEST live here
+    size_t memtable_bytes = 4u << 20;          // memtable is frozen and flushed past this size
+    size_t block_bytes = 4096;                 // target size of an SSTable data block
+    size_t table_bytes = 2u << 20;             // compaction output files are cut at this size
+    int bloom_bits_per_key = 10;               // ~1% false positives
+    int l0_compaction_trigger = 4;             // L0 file count that starts an L0 → L1 compaction
+    int l0_stop_writes = 12;                   // writers wait for compaction past this many L0 files
+    uint64_t level1_bytes = 10ull << 20;       // size limit of L1, each deeper level is 10x larger
+    int max_levels = 7;
+    bool sync_writes = true;                   // fdatasync the WAL before acknowledging a write
+};
+
+
+class LSMStore : public KVStore {
+public:
+    explicit LSMStore(LSMOptions opts) : opts_(std::move(opts)) {}
+
+    ~LSMStore() override {
+        {   std::lock_guard<std::mutex> st(state_mu_);
+            stopping_ = true; }
+        bg_cv_.notify_all();
+        if (bg_thread_.joinable()) bg_thread_.join();
+        std::lock_guard<std::mutex> w(write_mu_);
+        if (wal_) ::fdatasync(wal_->fd);
+    }
+
+
+    // recover tables from the MANIFEST, replay leftover WAL files and start the background thread
+    bool open(std::string &error) {
+        if (!make_dirs(opts_.dir)) { error = "cannot create " + opts_.dir + ": " + strerror(errno); return false; }
+        mem_ = std::make_shared<MemTable>();
+        auto version = std::make_shared<Version>(opts_.max_levels);
+
+        uint64_t max_number = 0;
+        std::ifstream manifest(opts_.dir + "/MANIFEST");
+        std::vector<uint64_t> live;
+        std::string word;
+        while (manifest >> word) {
+            if (word == "next") { manifest >> max_number; continue; }
+            int level; uint64_t number;
+            if (word != "table" || !(manifest >> level >> number) || level < 0 || level >= opts_.max_levels) {
+                error = "corrupt MANIFEST in " + opts_.dir; return false;
+            }
+            auto t = Table::open(table_path(number), number, error);
+            if (!t) return false;
+            version->levels[level].push_back(t);
+            live.push_back(number);
+            last_seq_ = std::max(last_seq_, t->max_seq);
+        }
+        for (int l = 0; l < opts_.max_levels; l++) sort_level(*version, l);
+
+        // WAL files still on disk hold writes that never made it into a table
+        std::vector<uint64_t> logs;
+        DIR *d = ::opendir(opts_.dir.c_str());
+        if (!d) { error = "cannot open " + opts_.dir; return false; }
+        while (dirent *e = ::readdir(d)) {
+            std::string n = e->d_name;
+            if (!ends_with(n, ".log") && !ends_with(n, ".sst")) continue;
+            uint64_t number = std::stoull(n.substr(0, n.size() - 4));
+            max_number = std::max(max_number, number);
+            if (ends_with(n, ".log")) logs.push_back(number);
+            else if (std::find(live.begin(), live.end(), number) == live.end())
+                ::unlink((opts_.dir + "/" + n).c_str());       // output of an interrupted compaction
+        }
+        ::closedir(d);
+        next_file_ = max_number + 1;
+        current_ = version;
+
+        std::sort(logs.begin(), logs.end());
+        for (uint64_t number : logs) replay_log(number);
+        if (!mem_->empty()) {                               // persist the replayed writes right away
+            auto t = write_table(mem_->entries(), error);
+            if (!t) return false;
+            auto v = std::make_shared<Version>(*current_);
+            v->levels[0].insert(v->levels[0].begin(), t);
+            current_ = v;
+            mem_ = std::make_shared<MemTable>();
+        }
+        if (!write_manifest(*current_, error)) return false;
+        for (uint64_t number : logs) ::unlink(log_path(number).c_str());
+
+        std::lock_guard<std::mutex> w(write_mu_);
+        if (!new_wal(error)) return false;
+        bg_thread_ = std::thread([this] { background_loop(); });
+        return true;
+    }
+
+    const char *name() const override { return "lsm"; }
+
+
+    // the entry's sequence number doubles as the version
+    StoreStatus get(const std::string &key, std::string &value, std::string &error, uint64_t *version) override {
+        gets_++;
+        std::shared_ptr<MemTable> mem, imm;
+        std::shared_ptr<const Version> v;
+        {   std::lock_guard<std::mutex> st(state_mu_);
+            mem = mem_; imm = imm_; v = current_;
+        }
+        uint64_t seq = 0;
+        Lookup r = mem->get(key, value, seq);
+        if (r == Lookup::ABSENT && imm) r = imm->get(key, value, seq);
+        if (version) *version = seq;
+        if (r != Lookup::ABSENT) return r == Lookup::FOUND ? StoreStatus::OK : StoreStatus::NOT_FOUND;
+
+        // L0 files overlap, newest first; deeper levels have at most one candidate file each
+        for (int l = 0; l < (int)v->levels.size(); l++) {
+            const auto &files = v->levels[l];
+            if (l == 0) {
+                for (auto &t : files) {
+                    if (key < t->smallest || key > t->largest) continue;
+                    r = probe(*t, key, value, seq, error);
+                    if (r != Lookup::ABSENT) break;
+                }
+            } else {
+                auto it = std::lower_bound(files.begin(), files.end(), key,
+                    [](const std::shared_ptr<Table> &t, const std::string &k) { return t->largest < k; });
+                if (it != files.end() && key >= (*it)->smallest) r = probe(**it, key, value, seq, error);
+            }
+            if (!error.empty()) return StoreStatus::ERROR;
+            if (version) *version = seq;
+            if (r != Lookup::ABSENT) return r == Lookup::FOUND ? StoreStatus::OK : StoreStatus::NOT_FOUND;
+        }
+        return StoreStatus::NOT_FOUND;
+    }
+
+
+    // `created` costs an extra lookup, only pass it when the answer is needed
+    StoreStatus put(const std::string &key, const std::string &value, std::string &error, bool *created, uint64_t *version) override {
+        puts_++;
+        if (created) {
+            std::string old;
+            StoreStatus st = get(key, old, error, nullptr);
+            if (st == StoreStatus::ERROR) return st;
+            *created = (st == StoreStatus::NOT_FOUND);
+        }
+        return write(key, &value, error, true, version);
+    }
+
+
+    // bulk ingest: append the whole batch to the WAL, then one fdatasync covers all of it
+    StoreStatus put_many(const std::vector<std::pair<std::string, std::string>> &kvs, std::string &error) override {
+        for (const auto &kv : kvs) {
+            puts_++;
+            if (write(kv.first, &kv.second, error, false) == StoreStatus::ERROR) return StoreStatus::ERROR;
+        }
+        uint64_t seq;
+        {   std::lock_guard<std::mutex> w(write_mu_);
+            seq = last_seq_;
+        }
+        if (opts_.sync_writes && !sync_until(seq, error)) return StoreStatus::ERROR;
+        return StoreStatus::OK;
+    }
+
+
+    // deletes are blind tombstones, NOT_FOUND is decided by a read first so the API matches the other backends
+    StoreStatus erase(const std::string &key, std::string &error) override {
+        deletes_++;
+        std::string old;
+        StoreStatus st = get(key, old, error, nullptr);
+        if (st != StoreStatus::OK) return st;
+        return write(key, nullptr, error);
+    }
+
+
+    // MDELETE: tombstones for the keys a read finds, then one fdatasync covers all of them
+    StoreStatus erase_many(const std::vector<std::string> &keys, std::vector<EraseResult> &out, std::string &error) override {
+        out.assign(keys.size(), EraseResult::ABSENT);
+        bool wrote = false;
+        for (size_t i = 0; i < keys.size(); i++) {
+            deletes_++;
+            std::string old;
+            StoreStatus st = get(keys[i], old, error, nullptr);
+            if (st == StoreStatus::ERROR) return st;
+            if (st == StoreStatus::NOT_FOUND) continue;
+            if (write(keys[i], nullptr, error, false) == StoreStatus::ERROR) return StoreStatus::ERROR;
+            out[i] = EraseResult::DELETED;
+            wrote = true;
+        }
+        uint64_t seq;
+        {   std::lock_guard<std::mutex> w(write_mu_);
+            seq = last_seq_;
+        }
+        if (wrote && opts_.sync_writes && !sync_until(seq, error)) return StoreStatus::ERROR;
+        return StoreStatus::OK;
+    }
+
+
+    std::string stats_json() const override {
+        std::shared_ptr<const Version> v;
+        size_t mem_bytes;
+        bool imm;
+        {   std::lock_guard<std::mutex> st(state_mu_);
+            v = current_; mem_bytes = mem_->bytes(); imm = imm_ != nullptr;
+        }
+        uint64_t user = user_bytes_, written = wal_bytes_ + flush_bytes_ + compact_write_bytes_;
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(2);
+        ss << "{\"memtable_bytes\": " << mem_bytes << ", \"immutable_memtable\": " << (imm ? "true" : "false")
+           << ", \"levels\": [";
+        for (size_t l = 0; l < v->levels.size(); l++) {
+            uint64_t bytes = 0;
+            for (auto &t : v->levels[l]) bytes += t->file_size;
+            ss << (l ? ", " : "") << "{\"files\": " << v->levels[l].size() << ", \"bytes\": " << bytes << "}";
+        }
+        ss << "], \"gets\": " << gets_ << ", \"puts\": " << puts_ << ", \"deletes\": " << deletes_
+           << ", \"read_amplification\": {\"table_probes\": " << table_probes_
+           << ", \"bloom_skips\": " << bloom_skips_ << ", \"block_reads\": " << block_reads_
+           << ", \"block_reads_per_get\": " << (gets_ ? (double)block_reads_ / gets_ : 0.0) << "}"
+           << ", \"write_amplification\": {\"user_bytes\": " << user << ", \"wal_bytes\": " << wal_bytes_
+           << ", \"flush_bytes\": " << flush_bytes_ << ", \"compaction_bytes\": " << compact_write_bytes_
+           << ", \"factor\": " << (user ? (double)written / user : 0.0) << "}"
+           << ", \"compaction\": {\"flushes\": " << flushes_ << ", \"compactions\": " << compactions_
+           << ", \"bytes_read\": " << compact_read_bytes_ << ", \"bytes_written\": " << compact_write_bytes_
+           << ", \"dropped_entries\": " << dropped_entries_ << ", \"busy_ms\": " << compact_ms_
+           << ", \"write_stalls\": " << stalls_ << "}"
+           << ", \"fsyncs\": " << fsyncs_ << "}";
+        return ss.str();
+    }
+
+
+private:
+    enum : uint8_t { TYPE_VALUE = 1, TYPE_DELETE = 0 };
+    enum class Lookup { FOUND, DELETED, ABSENT };
+    static constexpr uint64_t TABLE_MAGIC = 0x4c534d5442310a00ull;   // "LSMTB1"
+    static constexpr size_t FOOTER = 56;                              // 3 x (offset, size) + magic
+
+    struct Entry {
+        std::string key, value;
+        uint64_t seq = 0;
+        uint8_t type = TYPE_VALUE;
+    };
+
+
+    /*---------------------------- memtable ----------------------------*/
+    // skiplist with one writer (the caller holds write_mu_) and any number of lock-free readers
+    class MemTable {
+    public:
+        static constexpr int MAX_HEIGHT = 12;
+
+        MemTable() : head_(new Node(MAX_HEIGHT)) {}
+        ~MemTable() {
+            Node *n = head_;
+            while (n) { Node *next = n->next[0].load(std::memory_order_relaxed); delete n; n = next; }
+        }
+
+        void add(const std::string &key, const std::string *value, uint64_t seq) {
+            Node *prev[MAX_HEIGHT];
+            Node *x = head_;
+            for (int l = height_.load(std::memory_order_relaxed) - 1; l >= 0; l--) {
+                Node *next;
+                while ((next = x->next[l].load(std::memory_order_acquire)) && before(next, key, seq)) x = next;
+                prev[l] = x;
+            }
+            int h = random_height();
+            int cur = height_.load(std::memory_order_relaxed);
+            for (int l = cur; l < h; l++) prev[l] = head_;
+            if (h > cur) height_.store(h, std::memory_order_relaxed);
+
+            Node *n = new Node(h);
+            n->key = key;
+            n->seq = seq;
+            n->type = value ? TYPE_VALUE : TYPE_DELETE;
+            if (value) n->value = *value;
+            for (int l = 0; l < h; l++) {       // publish bottom-up so readers never see a half-linked node
+                n->next[l].store(prev[l]->next[l].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                prev[l]->next[l].store(n, std::memory_order_release);
+            }
+            bytes_ += key.size() + (value ? value->size() : 0) + 32;
+            count_++;
+        }
+
+        // newest version of `key`
+        Lookup get(const std::string &key, std::string &value, uint64_t &seq) const {
+            Node *x = head_;
+            for (int l = height_.load(std::memory_order_relaxed) - 1; l >= 0; l--) {
+                Node *next;
+                while ((next = x->next[l].load(std::memory_order_acquire)) && next->key < key) x = next;
+            }
+            x = x->next[0].load(std::memory_order_acquire);
+            if (!x || x->key != key) return Lookup::ABSENT;
+            seq = x->seq;
+            if (x->type == TYPE_DELETE) return Lookup::DELETED;
+            value = x->value;
+            return Lookup::FOUND;
+        }
+
+        // newest version of every key in key order (what a flush writes)
+        std::vector<Entry> entries() const {
+            std::vector<Entry> out;
+            out.reserve(count_);
+            for (Node *x = head_->next[0].load(std::memory_order_acquire); x; x = x->next[0].load(std::memory_order_acquire)) {
+                if (!out.empty() && out.back().key == x->key) continue;   // older version of the previous key
+                out.push_back({x->key, x->value, x->seq, x->type});
+            }
+            return out;
+        }
+
+        size_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+        bool empty() const { return count_.load() == 0; }
+
+    private:
+        struct Node {
+            explicit Node(int h) : height(h), next(new std::atomic<Node *>[h]) {
+                for (int i = 0; i < h; i++) next[i].store(nullptr, std::memory_order_relaxed);
+            }
+            std::string key, value;
+            uint64_t seq = 0;
+            uint8_t type = TYPE_VALUE;
+            int height;
+            std::unique_ptr<std::atomic<Node *>[]> next;
+        };
+
+        // ordering: key ascending, then seq descending (newest version first)
+        static bool before(const Node *n, const std::string &key, uint64_t seq) {
+            int c = n->key.compare(key);
+            return c < 0 || (c == 0 && n->seq > seq);
+        }
+
+        int random_height() {
+            int h = 1;
+            while (h < MAX_HEIGHT && (rng_() & 3) == 0) h++;   // branching factor 4
+            return h;
+        }
+
+        Node *head_;
+        std::atomic<int> height_{1};
+        std::atomic<size_t> bytes_{0}, count_{0};
+        std::minstd_rand rng_{0x5eed};
+    };
+
+
+    /*---------------------------- SSTable ----------------------------*/
+    //  data block entry : key_len(4) | val_len(4) | seq(8) | type(1) | key | value, block ends with crc32(4)
+    //  index entry      : last_key_len(4) | last_key | offset(8) | size(4)
+    //  bloom            : bit array | probe count(1)
+    //  meta             : smallest_len(4) | smallest | largest_len(4) | largest | entries(8) | max_seq(8)
+    //  footer           : index off/size | bloom off/size | meta off/size | magic   (8 bytes each)
+    struct BlockHandle { std::string last_key; uint64_t offset; uint32_t size; };
+
+    struct Table {
+        uint64_t number = 0;
+        int fd = -1;
+        std::string path;
+        uint64_t file_size = 0, entries = 0, max_seq = 0;
+        std::string smallest, largest;
+        std::vector<BlockHandle> index;
+        std::string bloom;
+        ~Table() { if (fd >= 0) ::close(fd); }
+
+        static std::shared_ptr<Table> open(const std::string &path, uint64_t number, std::string &error) {
+            auto t = std::make_shared<Table>();
+            t->number = number;
+            t->path = path;
+            t->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            char footer[FOOTER];
+            if (t->fd < 0 || ::fstat(t->fd, &st) != 0 || st.st_size < (off_t)FOOTER ||
+                !pread_all(t->fd, footer, FOOTER, st.st_size - FOOTER)) {
+                error = "cannot open table " + path;
+                return nullptr;
+            }
+            t->file_size = st.st_size;
+            uint64_t f[7];
+            memcpy(f, footer, FOOTER);
+            if (f[6] != TABLE_MAGIC) { error = "bad table footer in " + path; return nullptr; }
+            // every section has to lie in the file before the footer: a damaged footer must not size a buffer
+            uint64_t body = t->file_size - FOOTER;
+            for (int i = 0; i < 6; i += 2) {
+                if (f[i] > body || f[i + 1] > body - f[i]) { error = "bad table " + path + ": footer points past the end"; return nullptr; }
+            }
+
+            std::string index(f[1], '\0'), meta(f[5], '\0');
+            t->bloom.resize(f[3]);
+            if (!pread_all(t->fd, &index[0], index.size(), f[0]) || !pread_all(t->fd, &t->bloom[0], t->bloom.size(), f[2]) ||
+                !pread_all(t->fd, &meta[0], meta.size(), f[4])) {
+                error = "cannot read table " + path;
+                return nullptr;
+            }
+            size_t pos = 0;
+            while (pos + 4 <= index.size()) {
+                uint32_t klen;
+                memcpy(&klen, index.data() + pos, 4);
+                if (klen > index.size() - pos - 4 || index.size() - pos - 4 - klen < 12) {
+                    error = "bad table " + path + ": truncated index";
+                    return nullptr;
+                }
+                BlockHandle h;
+                h.last_key.assign(index.data() + pos + 4, klen);
+                memcpy(&h.offset, index.data() + pos + 4 + klen, 8);
+                memcpy(&h.size, index.data() + pos + 12 + klen, 4);
+                if (h.offset > f[0] || h.size > f[0] - h.offset) {   // data blocks come before the index
+                    error = "bad table " + path + ": index points past the data blocks";
+                    return nullptr;
+                }
+                t->index.push_back(std::move(h));
+                pos += 16 + klen;
+            }
+            pos = 0;
+            auto read_str = [&](std::string &out) {
+                uint32_t n;
+                if (meta.size() - pos < 4) return false;
+                memcpy(&n, meta.data() + pos, 4);
+                if (n > meta.size() - pos - 4) return false;
+                out.assign(meta.data() + pos + 4, n);
+                pos += 4 + n;
+                return true;
+            };
+            if (!read_str(t->smallest) || !read_str(t->largest) || meta.size() - pos < 16) {
+                error = "bad table " + path + ": truncated meta";
+                return nullptr;
+            }
+            memcpy(&t->entries, meta.data() + pos, 8);
+            memcpy(&t->max_seq, meta.data() + pos + 8, 8);
+            return t;
+        }
+    };
+
+    // bloom probes: double hashing over one 64-bit hash
+    static bool bloom_may_contain(const std::string &bloom, const std::string &key) {
+        if (bloom.size() < 2) return true;
+        size_t bits = (bloom.size() - 1) * 8;
+        int k = (uint8_t)bloom.back();
+        uint64_t h = hash64(key.data(), key.size()), delta = (h >> 33) | (h << 31);
+        for (int i = 0; i < k; i++, h += delta)
+            if (!(bloom[(h % bits) / 8] & (1 << ((h % bits) % 8)))) return false;
+        return true;
+    }
+
+    static std::string bloom_build(const std::vector<Entry> &entries, size_t begin, size_t end, int bits_per_key) {
+        size_t n = end - begin;
+        size_t bits = std::max<size_t>(64, n * bits_per_key);
+        int k = std::min(30, std::max(1, (int)std::lround(bits_per_key * 0.69)));   // ln 2 * bits/key
+        std::string bloom((bits + 7) / 8, '\0');
+        bits = bloom.size() * 8;
+        for (size_t i = begin; i < end; i++) {
+            const std::string &key = entries[i].key;
+            uint64_t h = hash64(key.data(), key.size()), delta = (h >> 33) | (h << 31);
+            for (int j = 0; j < k; j++, h += delta) bloom[(h % bits) / 8] |= (1 << ((h % bits) % 8));
+        }
+        bloom.push_back((char)k);
+        return bloom;
+    }
+
+    // bloom filter → index binary search → one block read
+    Lookup probe(const Table &t, const std::string &key, std::string &value, uint64_t &seq, std::string &error) {
+        table_probes_++;
+        if (!bloom_may_contain(t.bloom, key)) { bloom_skips_++; return Lookup::ABSENT; }
+        auto it = std::lower_bound(t.index.begin(), t.index.end(), key,
+            [](const BlockHandle &h, const std::string &k) { return h.last_key < k; });
+        if (it == t.index.end()) return Lookup::ABSENT;
+        std::string block(it->size, '\0');
+        block_reads_++;
+        if (!pread_all(t.fd, &block[0], block.size(), it->offset) || !check_block(block)) {
+            error = "corrupt block in " + t.path;
+            return Lookup::ABSENT;
+        }
+        Lookup result = Lookup::ABSENT;
+        for_each_in_block(block, [&](const char *k, uint32_t klen, const char *v, uint32_t vlen, uint64_t s, uint8_t type) {
+            if (klen != key.size() || memcmp(k, key.data(), klen) != 0) return true;
+            seq = s;
+            if (type == TYPE_DELETE) result = Lookup::DELETED;
+            else { value.assign(v, vlen); result = Lookup::FOUND; }
+            return false;
+        });
+        return result;
+    }
+
+    static bool check_block(const std::string &block) {
+        if (block.size() < 4) return false;
+        uint32_t crc;
+        memcpy(&crc, block.data() + block.size() - 4, 4);
+        return crc32(block.data(), block.size() - 4) == crc;
+    }
+
+    template <typename Fn>
+    static void for_each_in_block(const std::string &block, Fn fn) {
+        size_t pos = 0, end = block.size() - 4;
+        while (pos + 17 <= end) {
+            uint32_t klen, vlen;
+            uint64_t seq;
+            memcpy(&klen, block.data() + pos, 4);
+            memcpy(&vlen, block.data() + pos + 4, 4);
+            memcpy(&seq, block.data() + pos + 8, 8);
+            uint8_t type = block[pos + 16];
+            const char *k = block.data() + pos + 17;
+            if (!fn(k, klen, k + klen, vlen, seq, type)) return;
+            pos += 17 + klen + vlen;
+        }
+    }
+
+    // every entry of a table, in key order (compaction input)
+    bool read_table(const Table &t, std::vector<Entry> &out) {
+        for (auto &h : t.index) {
+            std::string block(h.size, '\0');
+            if (!pread_all(t.fd, &block[0], block.size(), h.offset) || !check_block(block)) return false;
+            for_each_in_block(block, [&](const char *k, uint32_t klen, const char *v, uint32_t vlen, uint64_t seq, uint8_t type) {
+                out.push_back({std::string(k, klen), std::string(v, vlen), seq, type});
+                return true;
+            });
+            compact_read_bytes_ += h.size;
+        }
+        return true;
+    }
+
+    // write entries[begin, end) (sorted, unique keys) as a new table file
+    std::shared_ptr<Table> write_table(const std::vector<Entry> &entries, std::string &error, size_t begin = 0, size_t end = SIZE_MAX) {
+        end = std::min(end, entries.size());
+        uint64_t number = next_file_++;
+        std::string file, block, index;
+        uint64_t max_seq = 0;
+        auto finish_block = [&](const std::string &last_key) {
+            uint32_t crc = crc32(block.data(), block.size());
+            block.append(reinterpret_cast<const char *>(&crc), 4);
+            uint64_t off = file.size();
+            uint32_t size = block.size(), klen = last_key.size();
+            index.append(reinterpret_cast<const char *>(&klen), 4);
+            index += last_key;
+            index.append(reinterpret_cast<const char *>(&off), 8);
+            index.append(reinterpret_cast<const char *>(&size), 4);
+            file += block;
+            block.clear();
+        };
+        for (size_t i = begin; i < end; i++) {
+            const Entry &e = entries[i];
+            uint32_t klen = e.key.size(), vlen = e.type == TYPE_VALUE ? e.value.size() : 0;
+            block.append(reinterpret_cast<const char *>(&klen), 4);
+            block.append(reinterpret_cast<const char *>(&vlen), 4);
+            block.append(reinterpret_cast<const char *>(&e.seq), 8);
+            block.push_back((char)e.type);
+            block += e.key;
+            if (vlen) block += e.value;
+            max_seq = std::max(max_seq, e.seq);
+            if (block.size() >= opts_.block_bytes || i + 1 == end) finish_block(e.key);
+        }
+        std::string bloom = bloom_build(entries, begin, end, opts_.bloom_bits_per_key), meta;
+        auto put_str = [&](const std::string &s) {
+            uint32_t n = s.size();
+            meta.append(reinterpret_cast<const char *>(&n), 4);
+            meta += s;
+        };
+        put_str(entries[begin].key);
+        put_str(entries[end - 1].key);
+        uint64_t count = end - begin;
+        meta.append(reinterpret_cast<const char *>(&count), 8);
+        meta.append(reinterpret_cast<const char *>(&max_seq), 8);
+
+        uint64_t f[7];
+        f[0] = file.size(); f[1] = index.size(); file += index;
+        f[2] = file.size(); f[3] = bloom.size(); file += bloom;
+        f[4] = file.size(); f[5] = meta.size();  file += meta;
+        f[6] = TABLE_MAGIC;
+        file.append(reinterpret_cast<const char *>(f), FOOTER);
+
+        if (!write_new_file(table_path(number), file)) { error = "cannot write table " + table_path(number); return nullptr; }
+        return Table::open(table_path(number), number, error);
+    }
+
+
+    /*---------------------------- versions ----------------------------*/
+    struct Version {
+        explicit Version(int n) : levels(n) {}
+        std::vector<std::vector<std::shared_ptr<Table>>> levels;   // L0 newest first, L1+ by smallest key
+    };
+
+    static void sort_level(Version &v, int level) {
+        auto &files = v.levels[level];
+        if (level == 0)
+            std::sort(files.begin(), files.end(), [](auto &a, auto &b) { return a->number > b->number; });
+        else
+            std::sort(files.begin(), files.end(), [](auto &a, auto &b) { return a->smallest < b->smallest; });
+    }
+
+    // MANIFEST is rewritten completely and renamed into place after every flush/compaction
+    bool write_manifest(const Version &v, std::string &error) {
+        std::stringstream ss;
+        ss << "next " << next_file_.load() << "\n";
+        for (size_t l = 0; l < v.levels.size(); l++)
+            for (auto &t : v.levels[l]) ss << "table " << l << " " << t->number << "\n";
+        std::string tmp = opts_.dir + "/MANIFEST.tmp";
+        if (!write_new_file(tmp, ss.str()) || ::rename(tmp.c_str(), (opts_.dir + "/MANIFEST").c_str()) != 0) {
+            error = "cannot write MANIFEST";
+            return false;
+        }
+        fsync_dir(opts_.dir);
+        return true;
+    }
+
+    std::string table_path(uint64_t n) const { return opts_.dir + "/" + std::to_string(n) + ".sst"; }
+    std::string log_path(uint64_t n) const { return opts_.dir + "/" + std::to_string(n) + ".log"; }
+
+
+    /*---------------------------- write path ----------------------------*/
+    struct WalFile {
+        uint64_t number = 0;
+        int fd = -1;
+        uint64_t size = 0;
+        ~WalFile() { if (fd >= 0) ::close(fd); }
+    };
+
+    // WAL record: crc32(4) | len(4) | seq(8) | type(1) | key_len(4) | key | value    (crc covers len..end)
+    // `wait_sync` false leaves the group commit to the caller (put_many syncs once per batch)
+    StoreStatus write(const std::string &key, const std::string *value, std::string &error, bool wait_sync = true,
+                      uint64_t *seq_out = nullptr) {
+        uint64_t seq;
+        {   std::lock_guard<std::mutex> w(write_mu_);
+            if (!make_room_locked(error)) return StoreStatus::ERROR;
+            seq = ++last_seq_;
+            uint32_t klen = key.size(), len = 13 + klen + (value ? value->size() : 0);
+            std::string rec(8, '\0');
+            rec.reserve(8 + len);
+            memcpy(&rec[4], &len, 4);
+            rec.append(reinterpret_cast<const char *>(&seq), 8);
+            rec.push_back((char)(value ? TYPE_VALUE : TYPE_DELETE));
+            rec.append(reinterpret_cast<const char *>(&klen), 4);
+            rec += key;
+            if (value) rec += *value;
+            uint32_t crc = crc32(rec.data() + 4, rec.size() - 4);
+            memcpy(&rec[0], &crc, 4);
+            if (!pwrite_all(wal_->fd, rec.data(), rec.size(), wal_->size)) {
+                error = "WAL append failed: " + std::string(strerror(errno));
+                return StoreStatus::ERROR;
+            }
+            wal_->size += rec.size();
+            wal_bytes_ += rec.size();
+            user_bytes_ += key.size() + (value ? value->size() : 0);
+            mem_->add(key, value, seq);
+        }
+        if (wait_sync && opts_.sync_writes && !sync_until(seq, error)) return StoreStatus::ERROR;
+        if (seq_out) *seq_out = seq;
+        return StoreStatus::OK;
+    }
+
+    // freeze a full memtable (waiting if the previous one is still being flushed) and
+    // hold writers back while L0 is too deep; caller holds write_mu_
+    bool make_room_locked(std::string &error) {
+        std::unique_lock<std::mutex> st(state_mu_);
+        while (true) {
+            if (!bg_error_.empty()) { error = bg_error_; return false; }
+            if ((int)current_->levels[0].size() >= opts_.l0_stop_writes || (mem_->bytes() >= opts_.memtable_bytes && imm_)) {
+                stalls_++;
+                done_cv_.wait(st);
+                continue;
+            }
+            if (mem_->bytes() < opts_.memtable_bytes) return true;
+            if (::fdatasync(wal_->fd) == 0) fsyncs_++;     // writes in older logs count as synced
+            imm_ = mem_;
+            imm_log_ = wal_->number;
+            mem_ = std::make_shared<MemTable>();
+            if (!new_wal(error)) return false;
+            bg_cv_.notify_one();
+            return true;
+        }
+    }
+
+    bool new_wal(std::string &error) {
+        auto wal = std::make_shared<WalFile>();
+        wal->number = next_file_++;
+        wal->fd = ::open(log_path(wal->number).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (wal->fd < 0) { error = "cannot create WAL: " + std::string(strerror(errno)); return false; }
+        fsync_dir(opts_.dir);
+        wal_ = wal;
+        return true;
+    }
+
+    // group commit, same scheme as the bitcask engine
+    bool sync_until(uint64_t seq, std::string &error) {
+        std::lock_guard<std::mutex> lk(sync_mu_);
+        if (synced_seq_ >= seq) return true;
+        std::shared_ptr<WalFile> wal;
+        uint64_t target;
+        {   std::lock_guard<std::mutex> w(write_mu_);
+            wal = wal_;
+            target = last_seq_;
+        }
+        if (::fdatasync(wal->fd) != 0) { error = "fdatasync failed: " + std::string(strerror(errno)); return false; }
+        fsyncs_++;
+        synced_seq_ = target;
+        return true;
+    }
+
+    // re-apply a WAL left behind by a crash, stopping at the first torn or corrupt record
+    void replay_log(uint64_t number) {
+        int fd = ::open(log_path(number).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return;
+        std::string buf;
+        bool ok = read_file(fd, buf);
+        ::close(fd);
+        if (!ok) return;
+        size_t pos = 0;
+        while (pos + 8 <= buf.size()) {
+            uint32_t crc, len, klen;
+            memcpy(&crc, buf.data() + pos, 4);
+            memcpy(&len, buf.data() + pos + 4, 4);
+            if (len < 13 || pos + 8 + len > buf.size() || crc32(buf.data() + pos + 4, len + 4) != crc) break;
+            uint64_t seq;
+            memcpy(&seq, buf.data() + pos + 8, 8);
+            uint8_t type = buf[pos + 16];
+            memcpy(&klen, buf.data() + pos + 17, 4);
+            std::string key(buf.data() + pos + 21, klen);
+            std::string value(buf.data() + pos + 21 + klen, len - 13 - klen);
+            mem_->add(key, type == TYPE_VALUE ? &value : nullptr, seq);
+            last_seq_ = std::max(last_seq_, seq);
+            pos += 8 + len;
+        }
+    }
+
+
+    /*---------------------------- background work ----------------------------*/
+    // only this thread installs new versions, so it may read current_ without state_mu_
+    void background_loop() {
+        std::unique_lock<std::mutex> st(state_mu_);
+        while (!stopping_) {
+            std::string error;
+            bool ok = true;
+            if (imm_) {
+                auto imm = imm_;
+                uint64_t log = imm_log_;
+                st.unlock();
+                ok = flush_memtable(*imm, log, error);
+                st.lock();
+            } else {
+                int level = pick_compaction();
+                if (level < 0) { bg_cv_.wait_for(st, std::chrono::seconds(1)); continue; }
+                st.unlock();
+                ok = run_compaction(level, error);
+                st.lock();
+            }
+            if (!ok) bg_error_ = error;
+            done_cv_.notify_all();
+            if (!ok) break;
+        }
+    }
+
+    // immutable memtable → new L0 table
+    bool flush_memtable(const MemTable &imm, uint64_t log, std::string &error) {
+        auto t = write_table(imm.entries(), error);
+        if (!t) return false;
+        auto v = std::make_shared<Version>(*current_);
+        v->levels[0].insert(v->levels[0].begin(), t);
+        if (!write_manifest(*v, error)) return false;
+        {   std::lock_guard<std::mutex> g(state_mu_);
+            current_ = v;
+            imm_ = nullptr;
+        }
+        ::unlink(log_path(log).c_str());
+        flushes_++;
+        flush_bytes_ += t->file_size;
+        return true;
+    }
+
+    bool run_compaction(int level, std::string &error) {
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::shared_ptr<Table>> inputs, outputs;
+        if (!compact(*current_, level, inputs, outputs, error)) return false;
+        auto v = std::make_shared<Version>(*current_);
+        for (int l : {level, level + 1}) {
+            auto &files = v->levels[l];
+            files.erase(std::remove_if(files.begin(), files.end(), [&](auto &t) {
+                return std::find(inputs.begin(), inputs.end(), t) != inputs.end(); }), files.end());
+        }
+        for (auto &t : outputs) v->levels[level + 1].push_back(t);
+        sort_level(*v, level + 1);
+        if (!write_manifest(*v, error)) return false;
+        {   std::lock_guard<std::mutex> g(state_mu_);
+            current_ = v;
+        }
+        for (auto &t : inputs) ::unlink(t->path.c_str());   // open readers keep their fd
+        compactions_++;
+        compact_ms_ += std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+        return true;
+    }
+
+    uint64_t level_limit(int level) const {
+        uint64_t limit = opts_.level1_bytes;
+        for (int l = 1; l < level; l++) limit *= 10;
+        return limit;
+    }
+
+    // level with the highest score >= 1, or -1
+    int pick_compaction() const {
+        double best = 1.0;
+        int level = -1;
+        for (int l = 0; l + 1 < (int)current_->levels.size(); l++) {
+            double score;
+            if (l == 0) score = (double)current_->levels[0].size() / opts_.l0_compaction_trigger;
+            else {
+                uint64_t bytes = 0;
+                for (auto &t : current_->levels[l]) bytes += t->file_size;
+                score = (double)bytes / level_limit(l);
+            }
+            if (score >= best) { best = score; level = l; }
+        }
+        return level;
+    }
+
+    static bool overlaps(const Table &t, const std::string &lo, const std::string &hi) {
+        return !(t.largest < lo || t.smallest > hi);
+    }
+
+    // merge the chosen inputs of `level` with the overlapping files of level+1
+    bool compact(const Version &v, int level, std::vector<std::shared_ptr<Table>> &inputs,
+                 std::vector<std::shared_ptr<Table>> &outputs, std::string &error) {
+        if (level == 0) {
+            inputs = v.levels[0];
+        } else {
+            // round robin through the key space of the level, one file at a time
+            const auto &files = v.levels[level];
+            auto it = std::find_if(files.begin(), files.end(), [&](auto &t) { return t->smallest > compact_pointer_[level]; });
+            inputs.push_back(it == files.end() ? files.front() : *it);
+        }
+        std::string lo = inputs.front()->smallest, hi = inputs.front()->largest;
+        for (auto &t : inputs) { lo = std::min(lo, t->smallest); hi = std::max(hi, t->largest); }
+        compact_pointer_[level] = hi;
+        for (auto &t : v.levels[level + 1]) if (overlaps(*t, lo, hi)) inputs.push_back(t);
+
+        std::vector<Entry> all;
+        for (auto &t : inputs) if (!read_table(*t, all)) { error = "corrupt table " + t->path; return false; }
+        std::sort(all.begin(), all.end(), [](const Entry &a, const Entry &b) {
+            int c = a.key.compare(b.key);
+            return c < 0 || (c == 0 && a.seq > b.seq);
+        });
+
+        // keep the newest version of each key, tombstones only while older data may exist below
+        std::vector<Entry> merged;
+        merged.reserve(all.size());
+        for (size_t i = 0; i < all.size(); i++) {
+            Entry &e = all[i];
+            bool shadowed = i > 0 && all[i - 1].key == e.key;   // an older version of the key before it
+            if (shadowed || (e.type == TYPE_DELETE && !exists_below(v, level + 1, e.key))) { dropped_entries_++; continue; }
+            merged.push_back({e.key, std::move(e.value), e.seq, e.type});   // key stays intact for the next comparison
+        }
+
+        size_t begin = 0, bytes = 0;
+        for (size_t i = 0; i < merged.size(); i++) {
+            bytes += merged[i].key.size() + merged[i].value.size() + 17;
+            if (bytes >= opts_.table_bytes || i + 1 == merged.size()) {
+                auto t = write_table(merged, error, begin, i + 1);
+                if (!t) return false;
+                compact_write_bytes_ += t->file_size;
+                outputs.push_back(t);
+                begin = i + 1;
+                bytes = 0;
+            }
+        }
+        return true;
+    }
+
+    // could a level deeper than `level` still hold an older version of `key`?
+    static bool exists_below(const Version &v, int level, const std::string &key) {
+        for (size_t l = level + 1; l < v.levels.size(); l++)
+            for (auto &t : v.levels[l])
+                if (key >= t->smallest && key <= t->largest) return true;
+        return false;
+    }
+
+
+    LSMOptions opts_;
+
+    std::mutex write_mu_;                          // one writer at a time: WAL append + memtable insert
+    std::shared_ptr<WalFile> wal_;
+    uint64_t last_seq_ = 0;
+    std::atomic<uint64_t> next_file_{1};
+
+    mutable std::mutex state_mu_;                  // guards mem_, imm_, current_ and the flags below
+    std::condition_variable bg_cv_, done_cv_;      // wake the background thread / stalled writers
+    std::shared_ptr<MemTable> mem_, imm_;
+    uint64_t imm_log_ = 0;
+    std::shared_ptr<const Version> current_;
+    std::string bg_error_;
+    bool stopping_ = false;
+    std::thread bg_thread_;
+    std::string compact_pointer_[16];
+
+    std::mutex sync_mu_;
+    uint64_t synced_seq_ = 0;
+
+    std::atomic<long> gets_{0}, puts_{0}, deletes_{0}, fsyncs_{0}, stalls_{0};
+    std::atomic<long> table_probes_{0}, bloom_skips_{0}, block_reads_{0};
+    std::atomic<long> flushes_{0}, compactions_{0}, dropped_entries_{0}, compact_ms_{0};
+    std::atomic<uint64_t> user_bytes_{0}, wal_bytes_{0}, flush_bytes_{0}, compact_read_bytes_{0}, compact_write_bytes_{0};
+};
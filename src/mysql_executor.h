@@ -0,0 +1,355 @@
+#pragma once
+/*=============================================================
+       Asynchronous MySQL executor (non-blocking client API)
+ ===============================================================
+ A few I/O threads each own a group of MySQL connections and drive them
+ with libmysqlclient's non-blocking calls (mysql_real_query_nonblocking,
+ mysql_store_result_nonblocking) from a poll() event loop. HTTP handler
+ threads only hand a statement over and sleep until its result arrives,
+ so a handful of I/O threads keep many queries in flight at once.
+
+ A statement that has not completed `timeout_ms` after submit() fails with
+ "DB timeout"; if it was already on the wire its connection is dropped.
+ Dropped connections (timeout, server gone away) are reopened by a separate
+ reconnect thread, since opening one blocks for up to the connect timeout
+ and would stall every statement of the I/O thread. Meanwhile statements go
+ to the thread's other connections; while all of them are down, statements
+ fail at once with "DB connection failed" instead of waiting.
+
+ Requires the MySQL 8.0.16+ client library (libmysqlclient-dev on Ubuntu).
+================================================================*/
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <mysql/mysql.h>
+
+// outcome of one statement; NULL columns come back as empty strings
+struct DBResult {
+    bool ok = false;
+    std::string error;
+    unsigned int error_code = 0;
+    std::vector<std::vector<std::string>> rows;
+    uint64_t affected_rows = 0;
+    uint64_t insert_id = 0;
+};
+
+using DBCallback = std::function<void(DBResult &&)>;
+
+
+class MySQLExecutor {
+public:
+    // `connect` opens one blocking connection (it is switched to non-blocking use afterwards), timeout_ms 0 = no deadline
+    MySQLExecutor(std::function<MYSQL *()> connect, int io_threads, int conns_per_thread, int timeout_ms = 0)
+        : connect_(std::move(connect)), conns_per_thread_(std::max(1, conns_per_thread)), timeout_(std::chrono::milliseconds(timeout_ms)) {
+        for (int i = 0; i < std::max(1, io_threads); i++) loops_.emplace_back(new IoLoop());
+    }
+
+    ~MySQLExecutor() {
+        {   std::lock_guard<std::mutex> lk(reconnect_mu_);
+            stopping_ = true;
+        }
+        reconnect_cv_.notify_all();
+        for (auto &l : loops_) wake(*l);
+        for (auto &l : loops_) if (l->worker.joinable()) l->worker.join();
+        if (reconnecter_.joinable()) reconnecter_.join();
+        for (auto &l : loops_) {
+            for (auto &c : l->conns) if (c.mysql) mysql_close(c.mysql);
+            for (auto &r : l->reopened) mysql_close(r.second);
+            if (l->event_fd >= 0) close(l->event_fd);
+        }
+    }
+
+    // open every connection and start the I/O threads
+    bool start(std::string &error) {
+        for (auto &l : loops_) {
+            l->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            for (int i = 0; i < conns_per_thread_; i++) {
+                Conn c;
+                c.mysql = connect_();
+                if (!c.mysql) { error = "DB connection failed"; return false; }
+                l->conns.push_back(c);
+            }
+        }
+        for (auto &l : loops_) {
+            IoLoop *loop = l.get();
+            loop->worker = std::thread([this, loop] { run_loop(*loop); });
+        }
+        reconnecter_ = std::thread([this] { run_reconnects(); });
+        return true;
+    }
+
+    // queue a statement, `done` runs on an I/O thread once the result is in
+    void submit(std::string sql, DBCallback done) {
+        IoLoop &l = *loops_[next_loop_++ % loops_.size()];
+        {   std::lock_guard<std::mutex> lk(l.mu);
+            l.queue.push_back(Job{std::move(sql), std::move(done), std::chrono::steady_clock::now()});
+        }
+        submitted_++;
+        wake(l);
+    }
+
+    // blocking convenience for handler threads: submit and wait for the result
+    DBResult run(std::string sql) {
+        auto p = std::make_shared<std::promise<DBResult>>();
+        auto f = p->get_future();
+        submit(std::move(sql), [p](DBResult &&r) { p->set_value(std::move(r)); });
+        return f.get();
+    }
+
+    std::string stats_json() const {
+        long done = completed_;
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        ss << "{\"io_threads\": " << loops_.size() << ", \"connections\": " << loops_.size() * conns_per_thread_
+           << ", \"queries\": " << submitted_ << ", \"errors\": " << errors_
+           << ", \"in_flight\": " << in_flight_ << ", \"max_in_flight\": " << max_in_flight_
+           << ", \"reconnects\": " << reconnects_ << ", \"connections_down\": " << down_ << ", \"timeouts\": " << timeouts_
+           << ", \"avg_latency_us\": " << (done ? (double)latency_us_ / done : 0.0) << "}";
+        return ss.str();
+    }
+
+private:
+    struct Job {
+        std::string sql;
+        DBCallback done;
+        std::chrono::steady_clock::time_point queued_at;
+    };
+
+    enum class Phase { IDLE, QUERY, STORE };
+
+    struct Conn {
+        MYSQL *mysql = nullptr;          // null while dropped, given no jobs until the reconnect thread reopens it
+        bool reopening = false;          // handed to the reconnect thread
+        Phase phase = Phase::IDLE;
+        bool waiting = false;            // counted in in_flight_ (statement handed to the server)
+        Job job;
+    };
+
+    struct IoLoop {
+        std::thread worker;
+        int event_fd = -1;
+        std::mutex mu;            // guards queue and reopened
+        std::deque<Job> queue;
+        std::vector<std::pair<size_t, MYSQL *>> reopened;   // connection index → new handle, from the reconnect thread
+        std::vector<Conn> conns;  // only touched by the loop's own thread after start()
+    };
+
+    static void wake(IoLoop &l) {
+        uint64_t one = 1;
+        if (write(l.event_fd, &one, sizeof(one)) < 0) {}   // counter overflow is impossible in practice
+    }
+
+    void run_loop(IoLoop &l) {
+        mysql_thread_init();
+        std::vector<pollfd> fds;
+        std::vector<Job> expired, unserved;
+        while (!stopping_) {
+            auto now = std::chrono::steady_clock::now();
+            // take back reopened connections, hand queued statements to idle connections
+            {   std::lock_guard<std::mutex> lk(l.mu);
+                for (auto &r : l.reopened) {
+                    l.conns[r.first].mysql = r.second;
+                    l.conns[r.first].reopening = false;
+                    down_--;
+                }
+                l.reopened.clear();
+                while (timeout_.count() && !l.queue.empty() && now - l.queue.front().queued_at > timeout_) {
+                    expired.push_back(std::move(l.queue.front()));   // never got a connection in time
+                    l.queue.pop_front();
+                }
+                bool any_up = false;
+                for (auto &c : l.conns) {
+                    if (!c.mysql) continue;
+                    any_up = true;
+                    if (l.queue.empty()) break;
+                    if (c.phase != Phase::IDLE) continue;
+                    c.job = std::move(l.queue.front());
+                    l.queue.pop_front();
+                    c.phase = Phase::QUERY;
+                }
+                if (!any_up) {                          // nothing to run them on until a reconnect succeeds
+                    for (auto &job : l.queue) unserved.push_back(std::move(job));
+                    l.queue.clear();
+                }
+            }
+            for (auto &job : expired) { timeouts_++; errors_++; completed_++; job.done(timeout_result()); }
+            expired.clear();
+            for (auto &job : unserved) { errors_++; completed_++; job.done(connection_failed()); }
+            unserved.clear();
+
+            bool busy = false;
+            for (auto &c : l.conns) {
+                if (c.phase == Phase::IDLE) continue;
+                drive(c);
+                if (c.phase != Phase::IDLE && timeout_.count() && now - c.job.queued_at > timeout_) {
+                    mysql_close(c.mysql);           // the reply may still arrive, the handle is unusable mid-protocol
+                    c.mysql = nullptr;              // reopened by the reconnect thread, see below
+                    timeouts_++;
+                    finish(c, timeout_result());
+                }
+                busy = busy || c.phase != Phase::IDLE;
+            }
+            for (size_t i = 0; i < l.conns.size(); i++) {
+                Conn &c = l.conns[i];
+                if (c.mysql || c.reopening) continue;
+                c.reopening = true;
+                down_++;
+                {   std::lock_guard<std::mutex> lk(reconnect_mu_);
+                    reconnects_wanted_.push_back({&l, i});
+                }
+                reconnect_cv_.notify_one();
+            }
+
+            fds.clear();
+            fds.push_back({l.event_fd, POLLIN, 0});
+            for (auto &c : l.conns)
+                if (c.phase != Phase::IDLE) fds.push_back({c.mysql->net.fd, POLLIN, 0});
+            // a statement still being sent or data buffered inside the client library (TLS) does not
+            // raise POLLIN, so busy connections are re-driven at least every millisecond
+            int n = poll(fds.data(), fds.size(), busy ? 1 : 100);
+            if (n > 0 && (fds[0].revents & POLLIN)) {
+                uint64_t v;
+                if (read(l.event_fd, &v, sizeof(v)) < 0) {}
+            }
+        }
+        mysql_thread_end();
+    }
+
+    // reopens dropped connections one at a time, off the I/O threads: connect_() blocks
+    void run_reconnects() {
+        mysql_thread_init();
+        std::unique_lock<std::mutex> lk(reconnect_mu_);
+        while (true) {
+            reconnect_cv_.wait(lk, [&] { return stopping_ || !reconnects_wanted_.empty(); });
+            if (stopping_) break;
+            std::pair<IoLoop *, size_t> want = reconnects_wanted_.front();
+            reconnects_wanted_.pop_front();
+            lk.unlock();
+            reconnects_++;
+            MYSQL *m = connect_();
+            lk.lock();
+            if (!m) {                               // server still down: retry after a pause, behind the others
+                reconnects_wanted_.push_back(want);
+                reconnect_cv_.wait_for(lk, std::chrono::milliseconds(200), [&] { return stopping_.load(); });
+                continue;
+            }
+            {   std::lock_guard<std::mutex> ll(want.first->mu);
+                want.first->reopened.push_back({want.second, m});   // closed by the destructor if the loop is gone
+            }
+            wake(*want.first);
+        }
+        lk.unlock();
+        mysql_thread_end();
+    }
+
+    // advance one connection's state machine as far as it goes without blocking
+    void drive(Conn &c) {
+        while (true) {
+            if (c.phase == Phase::QUERY) {
+                net_async_status st = mysql_real_query_nonblocking(c.mysql, c.job.sql.data(), c.job.sql.size());
+                if (st == NET_ASYNC_NOT_READY) { note_in_flight(c); return; }
+                if (st == NET_ASYNC_ERROR) { finish(c, fail(c.mysql)); return; }
+                if (mysql_field_count(c.mysql) == 0) {          // INSERT / DELETE ... no result set
+                    DBResult r;
+                    r.ok = true;
+                    r.affected_rows = mysql_affected_rows(c.mysql);
+                    r.insert_id = mysql_insert_id(c.mysql);
+                    finish(c, std::move(r));
+                    return;
+                }
+                c.phase = Phase::STORE;
+            }
+            if (c.phase == Phase::STORE) {
+                MYSQL_RES *res = nullptr;
+                net_async_status st = mysql_store_result_nonblocking(c.mysql, &res);
+                if (st == NET_ASYNC_NOT_READY) { note_in_flight(c); return; }
+                if (st == NET_ASYNC_ERROR || !res) { finish(c, fail(c.mysql)); return; }
+                DBResult r;
+                r.ok = true;
+                unsigned int cols = mysql_num_fields(res);
+                while (MYSQL_ROW row = mysql_fetch_row(res)) {     // stored result: no further I/O
+                    unsigned long *len = mysql_fetch_lengths(res);
+                    std::vector<std::string> out(cols);
+                    for (unsigned int i = 0; i < cols; i++) if (row[i]) out[i].assign(row[i], len[i]);
+                    r.rows.push_back(std::move(out));
+                }
+                mysql_free_result(res);
+                finish(c, std::move(r));
+                return;
+            }
+            return;
+        }
+    }
+
+    static DBResult timeout_result() {
+        DBResult r;
+        r.error = "DB timeout";
+        return r;
+    }
+
+    static DBResult connection_failed() {
+        DBResult r;
+        r.error = "DB connection failed";
+        return r;
+    }
+
+    DBResult fail(MYSQL *m) {
+        DBResult r;
+        r.error = std::string("DB error: ") + mysql_error(m);
+        r.error_code = mysql_errno(m);
+        return r;
+    }
+
+    void note_in_flight(Conn &c) {
+        if (c.waiting) return;
+        c.waiting = true;
+        long now = ++in_flight_;
+        long prev = max_in_flight_;
+        while (now > prev && !max_in_flight_.compare_exchange_weak(prev, now)) {}
+    }
+
+    void finish(Conn &c, DBResult &&r) {
+        if (c.waiting) { c.waiting = false; in_flight_--; }
+        if (!r.ok) {
+            errors_++;
+            // 2006 server gone away / 2013 lost connection: drop the handle, the reconnect thread reopens it
+            if (c.mysql && (r.error_code == 2006 || r.error_code == 2013)) {
+                mysql_close(c.mysql);
+                c.mysql = nullptr;
+            }
+        }
+        latency_us_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - c.job.queued_at).count();
+        completed_++;
+        c.phase = Phase::IDLE;
+        DBCallback done = std::move(c.job.done);
+        c.job = Job();
+        done(std::move(r));
+    }
+
+    std::function<MYSQL *()> connect_;
+    int conns_per_thread_;
+    const std::chrono::milliseconds timeout_;
+    std::vector<std::unique_ptr<IoLoop>> loops_;
+    std::atomic<unsigned> next_loop_{0};
+    std::atomic<bool> stopping_{false};
+    std::thread reconnecter_;
+    std::mutex reconnect_mu_;                                    // guards reconnects_wanted_
+    std::condition_variable reconnect_cv_;
+    std::deque<std::pair<IoLoop *, size_t>> reconnects_wanted_;  // dropped connections, by loop and index
+    std::atomic<long> submitted_{0}, completed_{0}, errors_{0}, reconnects_{0}, timeouts_{0}, in_flight_{0}, max_in_flight_{0};
+    std::atomic<long> down_{0};                                  // connections dropped and not reopened yet
+    std::atomic<long long> latency_us_{0};
+};
@@ -0,0 +1,654 @@
+#pragma once
+/*=============================================================
+                 MySQL storage tier (default backend)
+================================================================*/
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <mysql/mysql.h>
+#include "kv_store.h"
+#include "mysql_executor.h"
+#include "binlog_tailer.h"
+#include "latency.h"
+
+
+
+/*=============================================================
+                        MySQL connecting
+ ===============================================================*/
+// one mysqld instance the partitions are spread over
+struct DBEndpoint {
+    std::string host = "127.0.0.1";
+    unsigned int port = 0;     // 0 → default MySQL port 3306
+};
+
+inline MYSQL* connect_db(const DBEndpoint &ep = DBEndpoint(), unsigned int timeout_s = 2) {
+    // Initialize a new MySQL connection handle, mysql_init() prepares a connection object for further use.
+    MYSQL *conn = mysql_init(nullptr);
+    if (!conn) return nullptr; // If initialization failed, return null (connection object invalid).
+
+    // Bound connect and every blocking read/write so a stalled server cannot hang the caller forever
+    // (statements run by MySQLExecutor are non-blocking and get their own per-statement deadline).
+    mysql_options(conn, MYSQL_OPT_CONNECT_TIMEOUT, &timeout_s);
+    mysql_options(conn, MYSQL_OPT_READ_TIMEOUT, &timeout_s);
+    mysql_options(conn, MYSQL_OPT_WRITE_TIMEOUT, &timeout_s);
+
+    /* Try connecting to the MySQL server using provided credentials:
+    - Host: ep.host  (127.0.0.1, local machine, unless --db-hosts says otherwise)
+    - User: user_744
+    - Password: key_744
+    - Database: key_value_DB_744
+    - Port: ep.port (0 means the default MySQL port 3306 will be used)
+    - Socket and client flags set to nullptr and 0 */
+    if (!mysql_real_connect(conn, ep.host.c_str(), "user_744", "key_744", "key_value_DB_744", ep.port, nullptr, 0)) {
+        std::cerr << "MySQL connection failed (" << ep.host << ":" << (ep.port ? ep.port : 3306) << "): " << mysql_error(conn) << std::endl; // If connection fails, print an error message from MySQL.
+        mysql_close(conn);// Close and free the connection handle to avoid leaks.
+        return nullptr; // Return nullptr to indicate failure to caller.
+    }
+    return conn;// Return the valid connection object to the caller, the partition tables are created by MySQLStore::open().
+}
+
+// table holding partition p of n (a single partition keeps the original key_value_table name)
+inline std::string partition_table(int p, int partitions) {
+    return partitions == 1 ? "key_value_table" : "key_value_table_" + std::to_string(p);
+}
+
+// function to escape string literals for SQL, Prevents SQL injection or syntax errors.
+// Quotes and backslashes get a backslash, control characters MySQL treats specially use their escape sequence.
+inline std::string escape_sql(const std::string &s) {
+    std::string out;
+    out.reserve(s.size() + s.size() / 8);
+    for (char c : s) {      // Iterate through every character in the input string.
+        switch (c) {
+            case '\'': out += "\\'"; break;    // If the character is a single quote ('), append an escaped version.
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break; // a lone backslash would otherwise escape the next character
+            case '\0': out += "\\0"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\x1a': out += "\\Z"; break;
+            default:   out += c;
+        }
+    }
+    return out;  // Return the sanitized SQL-safe string.
+}
+
+
+
+
+// Versions for the `ver` column: microseconds since the epoch, forced to grow by at least one per call
+// (a hybrid logical clock), so later writes from this server always carry a larger version.
+class VersionClock {
+public:
+    uint64_t next() {
+        uint64_t now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        uint64_t prev = last_.load(std::memory_order_relaxed), v;
+        do { v = std::max(now, prev + 1); } while (!last_.compare_exchange_weak(prev, v, std::memory_order_relaxed));
+        return v;
+    }
+private:
+    std::atomic<uint64_t> last_{0};
+};
+
+
+
+
+/*=============================================================
+      KVStore over hash-partitioned tables (MySQL executors)
+ ===============================================================
+ Keys are spread over `partitions` tables by hash64(key) % partitions:
+ key_value_table_0 .. key_value_table_<N-1> (a single partition keeps the
+ original key_value_table name). Partition p lives on endpoint
+ p % endpoints, and every endpoint has its own MySQLExecutor, so each
+ mysqld instance gets its own connection pool.
+
+ Statements go through the executors, so concurrent handler threads are
+ spread over many non-blocking connections instead of queueing on one
+ handle behind a mutex.
+
+ Every row carries a version in `ver` (BIGINT UNSIGNED). A write sets it to
+ GREATEST(ver + 1, clock) so it grows on every write of the key even if the
+ clock of another writer is behind, and reads it back with the
+ LAST_INSERT_ID(expr) trick in the same statement.
+
+ With miss batching on, get() does not query alone: the first miss of a
+ partition waits `window_us` for others, then one
+ SELECT k, v, ver ... WHERE k IN (...) answers all of them (a batch also
+ goes out early once it holds `max_keys`).
+
+ With hedging on, a read that has not answered after the chosen percentile
+ of recent read latencies is sent a second time; the executor hands it to
+ another idle connection and whichever answer comes first is used.
+================================================================*/
+class MySQLStore : public KVStore {
+public:
+    // timeout_ms bounds every statement (executor deadline) and, rounded up to seconds, connects and blocking reads
+    MySQLStore(const std::vector<DBEndpoint> &endpoints, int partitions, int io_threads, int conns_per_thread, int timeout_ms)
+        : endpoints_(endpoints.empty() ? std::vector<DBEndpoint>{DBEndpoint()} : endpoints),
+          partitions_(std::max(1, partitions)), timeout_s_(std::max(1, (timeout_ms + 999) / 1000)), ops_(new std::atomic<long>[partitions_]) {
+        for (auto &ep : endpoints_) {
+            unsigned int t = timeout_s_;
+            execs_.emplace_back(new MySQLExecutor([ep, t] { return connect_db(ep, t); }, io_threads, conns_per_thread, timeout_ms));
+        }
+        for (int p = 0; p < partitions_; p++) ops_[p] = 0;
+    }
+
+    // collect concurrent get()s of a partition for window_us into one IN-list query (0 = off)
+    void enable_miss_batching(int window_us, int max_keys) {
+        miss_window_ = std::chrono::microseconds(std::max(0, window_us));
+        miss_max_keys_ = std::max(1, max_keys);
+        if (window_us > 0) miss_queues_.reset(new MissQueue[partitions_]);
+    }
+
+    // re-send reads still unanswered after this percentile (e.g. 95) of recent read latencies (0 = off)
+    void enable_hedging(double percentile) { hedge_quantile_ = std::max(0.0, std::min(percentile, 100.0)) / 100; }
+
+    bool open(std::string &error) {
+        for (auto &e : execs_) if (!e->start(error)) return false;
+        // Create the partition tables if they don't already exist, `k` VARCHAR(255) PRIMARY KEY ensures uniqueness
+        for (int p = 0; p < partitions_; p++) {
+            DBResult r = exec_of(p).run("CREATE TABLE IF NOT EXISTS " + table(p) +
+                                        " (k VARCHAR(255) PRIMARY KEY, v TEXT, ver BIGINT UNSIGNED NOT NULL DEFAULT 0)");
+            if (!r.ok) { error = r.error; return false; }
+            // tables created before versioning: add the column (existing rows start at version 0)
+            r = exec_of(p).run("SELECT COUNT(*) FROM information_schema.COLUMNS WHERE TABLE_SCHEMA = DATABASE() "
+                               "AND TABLE_NAME = '" + table(p) + "' AND COLUMN_NAME = 'ver'");
+            if (r.ok && !r.rows.empty() && r.rows[0][0] == "0")
+                r = exec_of(p).run("ALTER TABLE " + table(p) + " ADD COLUMN ver BIGINT UNSIGNED NOT NULL DEFAULT 0");
+            if (!r.ok) { error = r.error; return false; }
+        }
+        return true;
+    }
+
+    const char *name() const override { return "mysql"; }
+
+
+    // SELECT the value (and version) of one key
+    StoreStatus get(const std::string &key, std::string &value, std::string &error, uint64_t *version) override {
+        int p = partition(key);
+        if (miss_queues_) {
+            MissWaiter w;
+            w.key = &key;
+            batched_get(p, w);
+            if (!w.retry) {
+                if (w.status == StoreStatus::OK) {
+                    value = std::move(w.value);
+                    if (version) *version = w.version;
+                }
+                if (w.status == StoreStatus::ERROR) error = std::move(w.error);
+                return w.status;
+            }
+        }
+        DBResult r = read_query(p, "SELECT v, ver FROM " + table(p) + " WHERE k='" + escape_sql(key) + "' LIMIT 1");
+        if (!r.ok) { error = r.error; return StoreStatus::ERROR; }
+        if (r.rows.empty()) return StoreStatus::NOT_FOUND;
+        value = std::move(r.rows[0][0]);
+        if (version) *version = strtoull(r.rows[0][1].c_str(), nullptr, 10);
+        return StoreStatus::OK;
+    }
+
+
+    // INSERT ... ON DUPLICATE KEY UPDATE — insert or overwrite, bumping the version
+    StoreStatus put(const std::string &key, const std::string &value, std::string &error, bool *created, uint64_t *version) override {
+        int p = partition(key);
+        uint64_t ver = clock_.next();
+        DBResult r = exec_of(p).run("INSERT INTO " + table(p) + " (k,v,ver) VALUES('" + escape_sql(key) + "','" + escape_sql(value) +
+                                    "'," + std::to_string(ver) + ") ON DUPLICATE KEY UPDATE v=VALUES(v), ver=LAST_INSERT_ID(GREATEST(ver+1, VALUES(ver)))");
+        if (!r.ok) { error = r.error; return StoreStatus::ERROR; }
+        bool inserted = (r.affected_rows == 1);             // 1 for a new row, 2 for an update of an existing one
+        if (created) *created = inserted;
+        if (version) *version = inserted ? ver : r.insert_id;   // an update returns the stored version via LAST_INSERT_ID(expr)
+        return StoreStatus::OK;
+    }
+
+
+    // DELETE — NOT_FOUND when no row was affected
+    StoreStatus erase(const std::string &key, std::string &error) override {
+        int p = partition(key);
+        DBResult r = exec_of(p).run("DELETE FROM " + table(p) + " WHERE k='" + escape_sql(key) + "'");
+        if (!r.ok) { error = r.error; return StoreStatus::ERROR; }
+        return r.affected_rows > 0 ? StoreStatus::OK : StoreStatus::NOT_FOUND;
+    }
+
+
+    // one SELECT ... WHERE k IN (...) per partition touched, all submitted at once; keys whose row came back under
+    // another spelling (column collation) are looked up again one by one
+    StoreStatus get_many(const std::vector<std::string> &keys, std::vector<KVRead> &out, std::string &error) override {
+        out.assign(keys.size(), KVRead());
+        std::vector<std::vector<size_t>> by_part(partitions_);
+        for (size_t i = 0; i < keys.size(); i++) by_part[partition(keys[i])].push_back(i);
+
+        std::mutex mu;
+        std::condition_variable done;
+        int pending = 0;
+        std::string first_error;
+        std::vector<bool> recheck(partitions_, false);
+        for (int p = 0; p < partitions_; p++) {
+            if (by_part[p].empty()) continue;
+            std::string sql = "SELECT k, v, ver FROM " + table(p) + " WHERE k IN (";
+            for (size_t j = 0; j < by_part[p].size(); j++) sql += (j ? ",'" : "'") + escape_sql(keys[by_part[p][j]]) + "'";
+            sql += ")";
+            { std::lock_guard<std::mutex> lk(mu); pending++; }
+            exec_of(p).submit(std::move(sql), [&, p](DBResult &&r) {
+                std::lock_guard<std::mutex> lk(mu);
+                if (!r.ok) {
+                    if (first_error.empty()) first_error = r.error;
+                } else {
+                    std::unordered_map<std::string, std::vector<size_t>> want;   // a key may be asked for twice
+                    for (size_t i : by_part[p]) want[keys[i]].push_back(i);
+                    size_t claimed = 0;
+                    for (auto &row : r.rows) {
+                        auto it = want.find(row[0]);
+                        if (it == want.end()) continue;
+                        for (size_t i : it->second) {
+                            out[i].found = true;
+                            out[i].value = row[1];
+                            out[i].version = strtoull(row[2].c_str(), nullptr, 10);
+                        }
+                        claimed++;
+                    }
+                    recheck[p] = claimed < r.rows.size();
+                }
+                if (--pending == 0) done.notify_all();
+            });
+        }
+        {   std::unique_lock<std::mutex> lk(mu);
+            done.wait(lk, [&] { return pending == 0; });
+        }
+        if (!first_error.empty()) { error = first_error; return StoreStatus::ERROR; }
+        for (int p = 0; p < partitions_; p++) {
+            if (!recheck[p]) continue;
+            for (size_t i : by_part[p]) {
+                if (out[i].found) continue;
+                StoreStatus st = get(keys[i], out[i].value, error, &out[i].version);
+                if (st == StoreStatus::ERROR) return st;
+                out[i].found = (st == StoreStatus::OK);
+            }
+        }
+        return StoreStatus::OK;
+    }
+
+
+    // per partition touched: SELECT k ... WHERE k IN (...) to learn which keys exist, then one DELETE ... WHERE
+    // k IN (...) of those, each round submitted at once for every partition; the affected row count of an IN-list
+    // DELETE does not tell which keys it hit. A partition with a single key skips the SELECT, and one whose rows come
+    // back under another spelling (column collation) is deleted key by key instead
+    StoreStatus erase_many(const std::vector<std::string> &keys, std::vector<EraseResult> &out, std::string &error) override {
+        out.assign(keys.size(), EraseResult::ABSENT);
+        std::vector<std::vector<size_t>> by_part(partitions_);
+        std::unordered_set<std::string> seen;                         // repeats stay ABSENT, the first one is deleted
+        for (size_t i = 0; i < keys.size(); i++)
+            if (seen.insert(keys[i]).second) by_part[partition(keys[i])].push_back(i);
+
+        std::mutex mu;
+        std::condition_variable done;
+        int pending = 0;
+        std::string first_error;
+        // one statement per non-empty list of `parts`, `use` runs under mu for every successful result
+        auto round = [&](const std::string &head, const std::vector<std::vector<size_t>> &parts, const std::function<void(int, DBResult &)> &use) {
+            for (int p = 0; p < partitions_; p++) {
+                if (parts[p].empty()) continue;
+                std::string sql = head + table(p) + " WHERE k IN (";
+                for (size_t j = 0; j < parts[p].size(); j++) sql += (j ? ",'" : "'") + escape_sql(keys[parts[p][j]]) + "'";
+                sql += ")";
+                { std::lock_guard<std::mutex> lk(mu); pending++; }
+                exec_of(p).submit(std::move(sql), [&, p](DBResult &&r) {
+                    std::lock_guard<std::mutex> lk(mu);
+                    if (!r.ok) {
+                        if (first_error.empty()) first_error = r.error;
+                    } else {
+                        use(p, r);
+                    }
+                    if (--pending == 0) done.notify_all();
+                });
+            }
+            std::unique_lock<std::mutex> lk(mu);
+            done.wait(lk, [&] { return pending == 0; });
+            return first_error.empty();
+        };
+
+        std::vector<std::vector<size_t>> checked(partitions_), found(partitions_);
+        std::vector<bool> one_by_one(partitions_, false);
+        for (int p = 0; p < partitions_; p++) (by_part[p].size() > 1 ? checked[p] : found[p]) = by_part[p];
+        bool ok = round("SELECT k FROM ", checked, [&](int p, DBResult &r) {
+            std::unordered_map<std::string, size_t> want;
+            for (size_t i : checked[p]) want.emplace(keys[i], i);
+            for (auto &row : r.rows) {
+                auto it = want.find(row[0]);
+                if (it == want.end()) { one_by_one[p] = true; found[p].clear(); return; }
+                found[p].push_back(it->second);
+            }
+        });
+        // a found key that another client deletes in between still counts as DELETED, it existed when the batch began
+        ok = ok && round("DELETE FROM ", found, [&](int p, DBResult &r) {
+            for (size_t i : found[p])
+                if (!checked[p].empty() || r.affected_rows > 0) out[i] = EraseResult::DELETED;
+        });
+        if (!ok) { error = first_error; return StoreStatus::ERROR; }
+        for (int p = 0; p < partitions_; p++) {
+            if (!one_by_one[p]) continue;
+            for (size_t i : by_part[p]) {
+                StoreStatus st = erase(keys[i], error);
+                if (st == StoreStatus::ERROR) return st;
+                if (st == StoreStatus::OK) out[i] = EraseResult::DELETED;
+            }
+        }
+        return StoreStatus::OK;
+    }
+
+
+    // multi-row INSERT ... ON DUPLICATE KEY UPDATE, one statement per partition every BULK_STATEMENT_BYTES,
+    // all statements are submitted at once so the batch is spread over every pooled connection
+    StoreStatus put_many(const std::vector<std::pair<std::string, std::string>> &kvs, std::string &error) override {
+        std::mutex mu;
+        std::condition_variable done;
+        int pending = 0;
+        std::string first_error;
+        std::vector<std::string> sql(partitions_);
+        auto flush = [&](int p) {
+            sql[p] += " ON DUPLICATE KEY UPDATE v=VALUES(v), ver=GREATEST(ver+1, VALUES(ver))";
+            { std::lock_guard<std::mutex> lk(mu); pending++; }
+            exec_of(p).submit(std::move(sql[p]), [&](DBResult &&r) {
+                std::lock_guard<std::mutex> lk(mu);
+                if (!r.ok && first_error.empty()) first_error = r.error;
+                if (--pending == 0) done.notify_all();
+            });
+            sql[p].clear();
+        };
+        for (const auto &kv : kvs) {
+            int p = partition(kv.first);
+            std::string &q = sql[p];
+            q += q.empty() ? "INSERT INTO " + table(p) + " (k,v,ver) VALUES " : ",";
+            q += "('" + escape_sql(kv.first) + "','" + escape_sql(kv.second) + "'," + std::to_string(clock_.next()) + ")";
+            if (q.size() >= BULK_STATEMENT_BYTES) flush(p);
+        }
+        for (int p = 0; p < partitions_; p++) if (!sql[p].empty()) flush(p);
+
+        std::unique_lock<std::mutex> lk(mu);
+        done.wait(lk, [&] { return pending == 0; });
+        if (!first_error.empty()) { error = first_error; return StoreStatus::ERROR; }
+        return StoreStatus::OK;
+    }
+
+
+    // SELECT k with mysql_use_result so rows are streamed instead of buffered client side,
+    // runs on its own blocking connection per partition since the executor only handles stored results
+    bool scan_keys(const std::function<void(const std::string &)> &fn, std::string &error) override {
+        for (int p = 0; p < partitions_; p++) {
+            MYSQL *conn = connect_db(endpoint_of(p), timeout_s_);
+            if (!conn) { error = "DB connection failed"; return false; }
+            bool ok = mysql_query(conn, ("SELECT k FROM " + table(p)).c_str()) == 0;
+            MYSQL_RES *r = ok ? mysql_use_result(conn) : nullptr;
+            if (r) {
+                while (MYSQL_ROW row = mysql_fetch_row(r)) {
+                    unsigned long *len = mysql_fetch_lengths(r);
+                    if (row[0]) fn(std::string(row[0], len[0]));
+                }
+                mysql_free_result(r);
+            }
+            ok = r && mysql_errno(conn) == 0;   // fetch_row also returns null when the stream breaks
+            if (!ok) error = std::string("DB error: ") + mysql_error(conn);
+            mysql_close(conn);
+            if (!ok) return false;
+        }
+        return true;
+    }
+
+    // InnoDB keeps a row estimate in information_schema, much cheaper than COUNT(*)
+    uint64_t estimated_keys() override {
+        uint64_t n = 0;
+        for (int p = 0; p < partitions_; p++) {
+            DBResult r = exec_of(p).run("SELECT TABLE_ROWS FROM information_schema.TABLES "
+                                        "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = '" + table(p) + "'");
+            if (r.ok && !r.rows.empty()) n += strtoull(r.rows[0][0].c_str(), nullptr, 10);
+        }
+        return n;
+    }
+
+
+    // tail the binary log of every endpoint, rows of the partition tables are passed to `on_row`;
+    // hold_mark: rows are reported before_mark until mark_binlog() (a key scan is about to start)
+    void follow_binlog(uint32_t server_id, BinlogTailer::RowCallback on_row, std::function<void()> on_reset, bool hold_mark = false) {
+        for (size_t i = 0; i < endpoints_.size(); i++) {
+            DBEndpoint ep = endpoints_[i];
+            unsigned int t = timeout_s_;
+            tailers_.emplace_back(new BinlogTailer([ep, t] { return connect_db(ep, t); }, "key_value_DB_744",
+                                                   server_id + i, t * 1000 / 2, on_row, on_reset));
+            if (hold_mark) tailers_.back()->hold_mark();
+            tailers_.back()->start();
+        }
+    }
+
+    // every tailer has opened its stream, waits up to `wait`
+    bool binlog_streaming(std::chrono::milliseconds wait) {
+        auto until = std::chrono::steady_clock::now() + wait;
+        for (auto &t : tailers_)
+            while (!t->streaming()) {
+                if (std::chrono::steady_clock::now() >= until) return false;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        return true;
+    }
+
+    // marks every tailer at the current end of its endpoint's binary log
+    bool mark_binlog(std::string &error) {
+        for (size_t i = 0; i < tailers_.size(); i++) {
+            std::string file;
+            uint64_t pos;
+            if (!tailers_[i]->end_position(file, pos)) { error = "cannot read the binlog position of endpoint " + std::to_string(i); return false; }
+            tailers_[i]->set_mark(file, pos);
+        }
+        return true;
+    }
+
+
+    // SELECT 1 on every endpoint
+    bool ping() override {
+        for (auto &e : execs_) if (!e->run("SELECT 1").ok) return false;
+        return true;
+    }
+
+
+    std::string stats_json() const override {
+        std::stringstream ss;
+        ss << "{\"partitions\": " << partitions_ << ", \"partition_ops\": [";
+        for (int p = 0; p < partitions_; p++) ss << (p ? ", " : "") << ops_[p];
+        ss << "]";
+        if (miss_queues_) {
+            long batches = miss_batches_, keys = miss_keys_;
+            ss << std::fixed << std::setprecision(2);
+            ss << ", \"miss_batching\": {\"window_us\": " << miss_window_.count() << ", \"batches\": " << batches
+               << ", \"keys\": " << keys << ", \"avg_batch\": " << (batches ? (double)keys / batches : 0.0)
+               << ", \"max_batch\": " << miss_max_batch_ << ", \"queries_saved\": " << keys - batches
+               << ", \"retried_alone\": " << miss_retries_ << ", \"batch_sizes\": {";
+            for (int i = 0; i < MISS_SIZE_BUCKETS; i++)
+                ss << (i ? ", " : "") << "\"" << MISS_SIZE_NAMES[i] << "\": " << miss_sizes_[i];
+            ss << "}}";
+        }
+        if (hedge_quantile_ > 0) {
+            long reads = hedge_reads_, hedged = hedges_;
+            ss << std::fixed << std::setprecision(2);
+            ss << ", \"hedging\": {\"percentile\": " << hedge_quantile_ * 100 << ", \"delay_us\": " << hedge_delay_us_
+               << ", \"reads\": " << reads << ", \"hedged\": " << hedged
+               << ", \"hedge_rate\": " << (reads ? 100.0 * hedged / reads : 0.0) << ", \"hedge_wins\": " << hedge_wins_
+               << ", \"read_latency\": " << read_latency_.stats_json() << "}";
+        }
+        ss << ", \"endpoints\": [";
+        for (size_t i = 0; i < endpoints_.size(); i++)
+            ss << (i ? ", " : "") << "{\"host\": \"" << endpoints_[i].host << ":" << (endpoints_[i].port ? endpoints_[i].port : 3306)
+               << "\", \"executor\": " << execs_[i]->stats_json()
+               << (i < tailers_.size() ? ", \"binlog\": " + tailers_[i]->stats_json() : std::string()) << "}";
+        ss << "]}";
+        return ss.str();
+    }
+
+
+private:
+    static constexpr size_t BULK_STATEMENT_BYTES = 256 * 1024;   // well below the default max_allowed_packet (64MB)
+    static constexpr int MISS_SIZE_BUCKETS = 5;
+    static constexpr const char *MISS_SIZE_NAMES[MISS_SIZE_BUCKETS] = {"1", "2-4", "5-16", "17-64", "65+"};
+
+    static constexpr long HEDGE_MIN_SAMPLES = 200;       // no hedging before the percentile means something
+    static constexpr long HEDGE_WINDOW_SAMPLES = 100000; // latencies older than this many reads are forgotten
+
+    // run a read statement; with hedging on, a copy goes out if the first has not answered within the hedge delay,
+    // the first successful answer wins (an error only when both failed)
+    DBResult read_query(int p, std::string sql) {
+        if (hedge_quantile_ <= 0) return exec_of(p).run(std::move(sql));
+        struct Race {
+            std::mutex mu;
+            std::condition_variable cv;
+            int outstanding = 1;
+            bool done = false, hedge_won = false;
+            DBResult r;
+        };
+        auto race = std::make_shared<Race>();
+        auto answer = [race](DBResult &&r, bool hedge) {
+            std::lock_guard<std::mutex> lk(race->mu);
+            race->outstanding--;
+            if (race->done || (!r.ok && race->outstanding > 0)) return;
+            race->done = true;
+            race->hedge_won = hedge;
+            race->r = std::move(r);
+            race->cv.notify_all();
+        };
+        uint64_t delay = hedge_delay();
+        auto t0 = std::chrono::steady_clock::now();
+        exec_of(p).submit(sql, [this, t0, answer](DBResult &&r) {
+            if (r.ok) read_latency_.record(std::chrono::steady_clock::now() - t0);   // first copies only, hedges would bias it low
+            answer(std::move(r), false);
+        });
+        std::unique_lock<std::mutex> lk(race->mu);
+        if (delay && !race->cv.wait_for(lk, std::chrono::microseconds(delay), [&] { return race->done; })) {
+            race->outstanding++;
+            hedges_++;
+            lk.unlock();
+            exec_of(p).submit(std::move(sql), [answer](DBResult &&r) { answer(std::move(r), true); });
+            lk.lock();
+        }
+        race->cv.wait(lk, [&] { return race->done; });
+        if (race->hedge_won) hedge_wins_++;
+        return std::move(race->r);
+    }
+
+    // hedge delay in microseconds, 0 until there are enough samples; recomputed every 256 reads. A new window
+    // keeps the previous delay until it has enough samples of its own
+    uint64_t hedge_delay() {
+        long n = hedge_reads_++;
+        if ((n & 255) == 0) {
+            if (read_latency_.count() > HEDGE_WINDOW_SAMPLES) read_latency_.reset();
+            if (read_latency_.count() >= HEDGE_MIN_SAMPLES) hedge_delay_us_ = read_latency_.percentile_us(hedge_quantile_);
+        }
+        return hedge_delay_us_;
+    }
+
+    // one get() waiting for its partition's next IN-list query
+    struct MissWaiter {
+        const std::string *key;
+        StoreStatus status = StoreStatus::NOT_FOUND;
+        std::string value, error;
+        uint64_t version = 0;
+        bool retry = false;        // the batch returned a row no key matched byte for byte (collation), ask alone
+        std::promise<void> done;
+    };
+
+    struct MissQueue {
+        std::mutex mu;
+        std::vector<MissWaiter *> waiting;
+        bool collecting = false;   // a waiter is sleeping out the window and will send what has gathered
+    };
+
+    // join the partition's next batch, the first waiter collects it; returns once `w` is answered
+    void batched_get(int p, MissWaiter &w) {
+        MissQueue &q = miss_queues_[p];
+        std::future<void> answered = w.done.get_future();
+        std::vector<MissWaiter *> batch;
+        bool collect = false;
+        {   std::lock_guard<std::mutex> lk(q.mu);
+            q.waiting.push_back(&w);
+            if ((int)q.waiting.size() >= miss_max_keys_) batch.swap(q.waiting);   // full, send now
+            else if (!q.collecting) q.collecting = collect = true;
+        }
+        if (collect) {
+            std::this_thread::sleep_for(miss_window_);
+            std::lock_guard<std::mutex> lk(q.mu);
+            batch.swap(q.waiting);
+            q.collecting = false;
+        }
+        if (!batch.empty()) send_batch(p, std::move(batch));
+        answered.wait();
+        if (w.retry) miss_retries_++;
+    }
+
+    void send_batch(int p, std::vector<MissWaiter *> batch) {
+        long n = batch.size(), prev = miss_max_batch_;
+        miss_batches_++;
+        miss_keys_ += n;
+        miss_sizes_[n == 1 ? 0 : n <= 4 ? 1 : n <= 16 ? 2 : n <= 64 ? 3 : 4]++;
+        while (n > prev && !miss_max_batch_.compare_exchange_weak(prev, n)) {}
+
+        std::string sql = "SELECT k, v, ver FROM " + table(p) + " WHERE k IN (";
+        for (size_t i = 0; i < batch.size(); i++) sql += (i ? ",'" : "'") + escape_sql(*batch[i]->key) + "'";
+        sql += ")";
+        DBResult r = read_query(p, std::move(sql));   // the sender is a waiting handler thread too
+        if (!r.ok) {
+            for (MissWaiter *w : batch) { w->status = StoreStatus::ERROR; w->error = r.error; }
+        } else {
+            // the same key may be waited for twice; a row nobody claims was matched by the column collation
+            // under another spelling (case, trailing spaces), the waiters left empty then ask on their own
+            std::unordered_map<std::string, size_t> rows;
+            for (size_t i = 0; i < r.rows.size(); i++) rows.emplace(r.rows[i][0], i);
+            std::vector<bool> claimed(r.rows.size());
+            for (MissWaiter *w : batch) {
+                auto it = rows.find(*w->key);
+                if (it == rows.end()) continue;
+                auto &row = r.rows[it->second];
+                w->status = StoreStatus::OK;
+                w->value = row[1];
+                w->version = strtoull(row[2].c_str(), nullptr, 10);
+                claimed[it->second] = true;
+            }
+            if (std::find(claimed.begin(), claimed.end(), false) != claimed.end())
+                for (MissWaiter *w : batch) w->retry = (w->status == StoreStatus::NOT_FOUND);
+        }
+        for (MissWaiter *w : batch) w->done.set_value();   // `w` lives on its handler's stack, not touched after this
+    }
+
+    int partition(const std::string &key) {
+        int p = (int)(hash64(key.data(), key.size()) % partitions_);
+        ops_[p]++;
+        return p;
+    }
+    std::string table(int p) const { return partition_table(p, partitions_); }
+    const DBEndpoint &endpoint_of(int p) const { return endpoints_[p % endpoints_.size()]; }
+    MySQLExecutor &exec_of(int p) { return *execs_[p % execs_.size()]; }
+
+    std::vector<DBEndpoint> endpoints_;
+    int partitions_;
+    unsigned int timeout_s_;
+    double hedge_quantile_ = 0;                           // 0 = hedging off
+    LatencyHistogram read_latency_;                       // first-copy read latencies the hedge delay is taken from
+    std::atomic<uint64_t> hedge_delay_us_{0};
+    std::atomic<long> hedge_reads_{0}, hedges_{0}, hedge_wins_{0};
+    std::vector<std::unique_ptr<MySQLExecutor>> execs_;   // one per endpoint
+    VersionClock clock_;
+    std::vector<std::unique_ptr<BinlogTailer>> tailers_;  // one per endpoint when follow_binlog() was called
+    std::unique_ptr<std::atomic<long>[]> ops_;            // statements per partition, shows how even the hash spreads load
+    std::chrono::microseconds miss_window_{0};
+    int miss_max_keys_ = 128;
+    std::unique_ptr<MissQueue[]> miss_queues_;            // per partition, null while miss batching is off
+    std::atomic<long> miss_batches_{0}, miss_keys_{0}, miss_max_batch_{0}, miss_retries_{0};
+    std::atomic<long> miss_sizes_[MISS_SIZE_BUCKETS] = {};
+};
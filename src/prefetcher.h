@@ -0,0 +1,183 @@
+#pragma once
+/*=============================================================
+          Sequential-scan prefetcher for numbered keys
+ ===============================================================
+ Keys are read as <prefix><number> ("user41", "17", "item_0042"). Every
+ GET that misses the cache is reported here; once the same prefix misses
+ on `trigger` consecutive numbers, the next `block` keys are fetched with
+ one get_many() (a single IN-list SELECT per partition on MySQL) by a
+ background thread and handed to the cache's low-priority prefetch area.
+ Hits on prefetched entries keep the window ahead of the reader, so a
+ client walking the key space misses once per block instead of per key.
+================================================================*/
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include "kv_store.h"
+
+struct PrefetchOptions {
+    int block = 32;                    // keys fetched ahead per range
+    int trigger = 2;                   // consecutive ascending misses of a prefix that start a scan
+    size_t max_streams = 4096;         // prefixes tracked at once, the table is reset beyond this
+    size_t max_jobs = 64;              // queued ranges, more are dropped while the store is behind
+    std::function<bool()> allow;                              // false = skip (circuit breaker open)
+    std::function<bool(const std::string &key)> may_exist;    // key filter, keys it rules out are not asked for
+    std::function<uint64_t(const std::string &key)> ticket;   // cache fill ticket, taken before the read
+    std::function<bool(const std::string &key)> pending;      // a queued (write-behind) write the store has not seen yet
+    std::function<void(const std::string &key, const std::string &value, uint64_t version, uint64_t ticket)> install;
+};
+
+
+class Prefetcher {
+public:
+    Prefetcher(KVStore &store, PrefetchOptions opts) : store_(store), opts_(std::move(opts)) {
+        opts_.block = std::max(1, opts_.block);
+        worker_ = std::thread([this] { run(); });
+    }
+
+    ~Prefetcher() {
+        {   std::lock_guard<std::mutex> lk(mu_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        worker_.join();
+    }
+
+    // a GET that missed the cache (prefetched_hit = false) or was answered by a prefetched entry
+    void observe(const std::string &key, bool prefetched_hit) {
+        std::string prefix;
+        uint64_t n;
+        size_t width;
+        if (!split_key(key, prefix, n, width)) return;
+        prefix += '\0' + std::to_string(width);          // "7" and "007" style keys are different streams
+        std::lock_guard<std::mutex> lk(mu_);
+        if (streams_.size() >= opts_.max_streams && !streams_.count(prefix)) streams_.clear();
+        Stream &s = streams_[prefix];
+        if (prefetched_hit) {
+            // reader is inside the prefetched window: fetch the next block once it is half used up
+            s.last = n;
+            if (s.fetched_upto && n + opts_.block / 2 >= s.fetched_upto) schedule(s, key, width, s.fetched_upto + 1);
+            return;
+        }
+        s.run = (n == s.last + 1) ? s.run + 1 : 1;
+        s.last = n;
+        if (s.run < opts_.trigger) return;
+        if (s.run == opts_.trigger) scans_++;
+        schedule(s, key, width, std::max(n + 1, s.fetched_upto + 1));
+    }
+
+    std::string stats_json() const {
+        std::lock_guard<std::mutex> lk(mu_);
+        std::stringstream ss;
+        ss << "{\"block\": " << opts_.block << ", \"streams\": " << streams_.size() << ", \"scans_detected\": " << scans_
+           << ", \"queries\": " << queries_ << ", \"keys_requested\": " << requested_ << ", \"keys_found\": " << found_
+           << ", \"dropped_ranges\": " << dropped_ << ", \"skipped_pending\": " << skipped_pending_
+           << ", \"errors\": " << errors_ << "}";
+        return ss.str();
+    }
+
+private:
+    struct Stream {
+        uint64_t last = 0;          // number of the last miss
+        int run = 0;                // consecutive ascending misses ending at `last`
+        uint64_t fetched_upto = 0;  // highest number already requested
+    };
+
+    // "<prefix><digits>", width > 0 when the digits are zero padded
+    static bool split_key(const std::string &key, std::string &prefix, uint64_t &n, size_t &width) {
+        size_t d = key.size();
+        while (d > 0 && isdigit((unsigned char)key[d - 1])) d--;
+        size_t digits = key.size() - d;
+        if (digits == 0 || digits > 18) return false;
+        prefix = key.substr(0, d);
+        n = std::stoull(key.substr(d));
+        width = (key[d] == '0' && digits > 1) ? digits : 0;
+        return true;
+    }
+
+    // queue numbers from..last+block of the stream `key` belongs to (caller holds mu_)
+    void schedule(Stream &s, const std::string &key, size_t width, uint64_t from) {
+        uint64_t to = s.last + opts_.block;
+        if (from > to) return;
+        s.fetched_upto = to;
+        if (jobs_.size() >= opts_.max_jobs) { dropped_++; return; }
+        size_t d = key.size();
+        while (d > 0 && isdigit((unsigned char)key[d - 1])) d--;
+        std::vector<std::string> keys;
+        for (uint64_t i = from; i <= to; i++) {
+            std::string num = std::to_string(i);
+            if (num.size() < width) num.insert(0, width - num.size(), '0');
+            keys.push_back(key.substr(0, d) + num);
+        }
+        jobs_.push_back(std::move(keys));
+        cv_.notify_one();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lk(mu_);
+        while (true) {
+            cv_.wait(lk, [&] { return stopping_ || !jobs_.empty(); });
+            if (stopping_) return;
+            std::vector<std::string> keys = std::move(jobs_.front());
+            jobs_.pop_front();
+            lk.unlock();
+            fetch(keys);
+            lk.lock();
+        }
+    }
+
+    void fetch(std::vector<std::string> &keys) {
+        if (opts_.allow && !opts_.allow()) return;
+        if (opts_.may_exist)
+            keys.erase(std::remove_if(keys.begin(), keys.end(), [&](const std::string &k) { return !opts_.may_exist(k); }), keys.end());
+        if (keys.empty()) return;
+        std::vector<uint64_t> tickets;
+        for (const std::string &k : keys) tickets.push_back(opts_.ticket(k));
+        // after the tickets: a write queued before this check is not in the store yet and the read would bring the
+        // old row back, one queued after it went through put_local() and moved the ticket, so install() refuses it
+        if (opts_.pending) {
+            size_t kept = 0;
+            for (size_t i = 0; i < keys.size(); i++) {
+                if (opts_.pending(keys[i])) { skipped_pending_++; continue; }
+                if (kept != i) {
+                    keys[kept] = std::move(keys[i]);
+                    tickets[kept] = tickets[i];
+                }
+                kept++;
+            }
+            keys.resize(kept);
+            tickets.resize(kept);
+            if (keys.empty()) return;
+        }
+        std::vector<KVRead> out;
+        std::string error;
+        queries_++;
+        requested_ += keys.size();
+        if (store_.get_many(keys, out, error) == StoreStatus::ERROR) { errors_++; return; }
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (!out[i].found) continue;
+            found_++;
+            opts_.install(keys[i], out[i].value, out[i].version, tickets[i]);
+        }
+    }
+
+    KVStore &store_;
+    PrefetchOptions opts_;
+    mutable std::mutex mu_;                            // guards streams_ and jobs_
+    std::condition_variable cv_;
+    std::unordered_map<std::string, Stream> streams_;  // per key prefix
+    std::deque<std::vector<std::string>> jobs_;
+    bool stopping_ = false;
+    long scans_ = 0, dropped_ = 0;
+    std::atomic<long> queries_{0}, requested_{0}, found_{0}, errors_{0}, skipped_pending_{0};
+    std::thread worker_;
+};
@@ -0,0 +1,458 @@
+#pragma once
+/*=============================================================
+        Redis protocol (RESP) listener for the key-value store
+ ===============================================================
+ A second port speaking the Redis serialization protocol, so clients
+ skip HTTP request parsing and header building altogether and standard
+ tools (redis-cli, redis-benchmark, memtier_benchmark --protocol=redis)
+ can drive the server. Commands run on the same cache, store, write-behind
+ queue and circuit breaker as the HTTP routes, through the callbacks in
+ RespCommands:
+
+   GET key            bulk string, or nil if the key does not exist
+   SET key value      +OK (a sync write, like PUT without X-Durability)
+   DEL key [key ...]  number of keys deleted
+   MGET key [key ...] array of bulk strings / nils
+   PING [msg], QUIT, COMMAND and CONFIG GET (empty answers, for the
+   benchmark tools' handshakes)
+
+ The loops mirror EventServer's epoll loops: edge-triggered sockets, one
+ SO_REUSEPORT listener per loop, input parsed where the last read
+ stopped. Commands that cannot touch the store (and GETs the cache
+ answers) are answered on the loop; at the first one that needs the
+ store, it and everything pipelined behind it go to the WorkerPool as
+ one task, whose replies come back in order through the loop's done
+ queue. Both RESP arrays and inline commands ("GET key\r\n") are read.
+================================================================*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <sstream>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include "httplib.h"
+#include "worker_pool.h"
+#include "event_server.h"
+
+constexpr size_t RESP_MAX_INLINE = 64 << 10;      // inline command line
+constexpr size_t RESP_MAX_BULK = 64 << 20;        // one argument, like EVENT_MAX_BODY
+constexpr long RESP_MAX_ARGS = 1 << 20;
+constexpr size_t RESP_MAX_BATCH = 1024;           // pipelined commands one worker task runs
+
+
+// the store side of the commands, the same functions the HTTP handlers call
+struct RespCommands {
+    std::function<void(const std::string &key, httplib::Response &)> get;  // 200 + body, 404, 500, 503
+    std::function<void(const std::string &key, const std::string &value, httplib::Response &)> set;
+    std::function<void(const std::string &key, httplib::Response &)> del;  // 200, 404 if it did not exist, 500, 503
+    std::function<bool(const std::string &key, std::shared_ptr<const std::string> &value)> hit;   // cache only, on the loop (optional)
+    // whole MGET / DEL in one store call, (status, body) per key; optional, per key get / del otherwise
+    std::function<void(const std::vector<std::string> &keys, std::vector<std::pair<int, std::string>> &)> get_many;
+    std::function<void(const std::vector<std::string> &keys, std::vector<std::pair<int, std::string>> &)> del_many;
+};
+
+
+class RespServer {
+public:
+    RespServer(WorkerPool &pool, RespCommands cmds, int loops) : pool_(pool), cmds_(std::move(cmds)), loop_count_(std::max(1, loops)) {}
+
+    ~RespServer() { stop(); }
+
+    bool start(const std::string &host, int port) {
+        EventServer::raise_fd_limit();
+        for (int i = 0; i < loop_count_; i++) {
+            std::unique_ptr<Loop> loop(new Loop);
+            loop->listen_fd = EventServer::listen_socket(host, port, true);
+            loop->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+            if (loop->listen_fd < 0 || loop->wake_fd < 0 || loop->epfd < 0) {
+                std::cerr << "RESP listener: cannot listen on " << host << ":" << port << ": " << strerror(errno) << "\n";
+                close_loop(*loop);
+                return false;
+            }
+            watch(*loop, loop->listen_fd, LISTEN_ID, EPOLLIN);
+            watch(*loop, loop->wake_fd, WAKE_ID, EPOLLIN | EPOLLET);
+            loops_.push_back(std::move(loop));
+        }
+        for (auto &loop : loops_) {
+            Loop *l = loop.get();
+            threads_.emplace_back([this, l] { run(*l); });
+        }
+        return true;
+    }
+
+    void stop() {
+        if (stopping_.exchange(true)) return;
+        for (auto &loop : loops_) notify(*loop);
+        for (auto &t : threads_) t.join();
+        for (auto &loop : loops_) close_loop(*loop);
+    }
+
+    std::string stats_json() const {
+        std::stringstream ss;
+        ss << "{\"loops\": " << loop_count_ << ", \"connections\": " << open_ << ", \"accepted\": " << accepted_
+           << ", \"commands\": " << commands_ << ", \"answered_on_loop\": " << on_loop_
+           << ", \"worker_tasks\": " << tasks_ << ", \"protocol_errors\": " << bad_ << ", \"rejected\": " << rejected_ << "}";
+        return ss.str();
+    }
+
+private:
+    static constexpr uint64_t LISTEN_ID = 0, WAKE_ID = 1;
+    using Args = std::vector<std::string>;
+
+    struct Conn {
+        int fd = -1;
+        std::string in;              // bytes read, in[0..pos) already parsed
+        size_t pos = 0;
+        std::string out;             // replies not written yet
+        size_t out_off = 0;
+        bool busy = false;           // a batch of this connection is with a worker
+        bool close_after = false;    // QUIT or protocol error: close once `out` is written
+        bool read_closed = false;    // peer sent FIN: the buffered commands are still answered
+    };
+
+    struct Done {
+        uint64_t id;
+        std::string replies;
+        bool close;
+    };
+
+    struct Loop {
+        int epfd = -1, listen_fd = -1, wake_fd = -1;
+        std::unordered_map<uint64_t, std::unique_ptr<Conn>> conns;   // only touched by the loop thread
+        uint64_t next_id = 2;
+        MpscQueue<Done> done;                               // replies of the worker tasks
+    };
+
+    void run(Loop &loop) {
+        epoll_event events[256];
+        while (!stopping_) {
+            int n = epoll_wait(loop.epfd, events, 256, 1000);
+            for (int i = 0; i < n; i++) {
+                uint64_t id = events[i].data.u64;
+                if (id == LISTEN_ID) accept_all(loop);
+                else if (id == WAKE_ID) finish(loop);
+                else io(loop, id, events[i].events);
+            }
+        }
+    }
+
+    void accept_all(Loop &loop) {
+        while (true) {
+            int fd = accept4(loop.listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EMFILE || errno == ENFILE) std::cerr << "RESP listener: out of file descriptors\n";
+                return;                                     // EAGAIN: drained
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            uint64_t id = loop.next_id++;
+            std::unique_ptr<Conn> c(new Conn);
+            c->fd = fd;
+            loop.conns.emplace(id, std::move(c));
+            watch(loop, fd, id, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+            accepted_++;
+            open_++;
+        }
+    }
+
+    void io(Loop &loop, uint64_t id, uint32_t events) {
+        auto it = loop.conns.find(id);
+        if (it == loop.conns.end()) return;
+        Conn &c = *it->second;
+        if (events & EPOLLERR) { close_conn(loop, id); return; }
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+            static thread_local char buf[EVENT_READ_BYTES];
+            while (true) {
+                ssize_t r = recv(c.fd, buf, sizeof(buf), 0);
+                if (r > 0) { c.in.append(buf, r); continue; }
+                if (r < 0 && errno == EINTR) continue;
+                if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                if (r == 0) { c.read_closed = true; break; }   // half-close, process() closes once all is answered
+                close_conn(loop, id);                       // reset, replies in flight are dropped
+                return;
+            }
+        }
+        process(loop, id, c);
+    }
+
+    // answers what it can on the loop, the rest of the buffered commands go to one worker task
+    void process(Loop &loop, uint64_t id, Conn &c) {
+        while (!c.busy && !c.close_after) {
+            Args args;
+            int r = parse(c, args);
+            if (r == 0) {                                   // incomplete, wait for more bytes...
+                c.close_after = c.read_closed;              // ...unless none will come: close once `out` is written
+                break;
+            }
+            if (r < 0) {
+                bad_++;
+                c.out += "-ERR Protocol error\r\n";
+                c.close_after = true;
+                break;
+            }
+            if (args.empty()) continue;                     // blank inline line
+            commands_++;
+            bool close = false;
+            if (local(args, c.out, close, true)) {
+                on_loop_++;
+                c.close_after = close;
+                continue;
+            }
+            auto batch = std::make_shared<std::vector<Args>>();
+            batch->push_back(std::move(args));
+            while (batch->size() < RESP_MAX_BATCH) {     // a protocol error stays in c.in for the next round
+                Args more;
+                if (parse(c, more) <= 0) break;
+                if (more.empty()) continue;
+                commands_++;
+                batch->push_back(std::move(more));
+            }
+            c.busy = true;
+            tasks_++;
+            Loop *l = &loop;
+            bool queued = pool_.enqueue([this, l, id, batch] {
+                std::string out;
+                bool close = false;
+                for (const Args &a : *batch) {
+                    execute(a, out, close);
+                    if (close) break;
+                }
+                if (l->done.push(Done{id, std::move(out), close})) notify(*l);
+            });
+            if (!queued) {
+                rejected_++;
+                c.busy = false;
+                for (size_t i = 0; i < batch->size(); i++) c.out += "-ERR server busy, try again\r\n";
+            }
+        }
+        c.in.erase(0, c.pos);
+        c.pos = 0;
+        flush(loop, id, c);
+    }
+
+    void finish(Loop &loop) {
+        uint64_t n;
+        while (read(loop.wake_fd, &n, sizeof(n)) > 0) {}
+        loop.done.drain([&](Done &d) {
+            auto it = loop.conns.find(d.id);
+            if (it == loop.conns.end()) return;             // client went away meanwhile
+            Conn &c = *it->second;
+            c.busy = false;
+            c.close_after = c.close_after || d.close;
+            c.out += d.replies;
+            process(loop, d.id, c);
+        });
+    }
+
+    // writes what the socket takes, closes once a closing connection has nothing left
+    void flush(Loop &loop, uint64_t id, Conn &c) {
+        while (c.out_off < c.out.size()) {
+            ssize_t w = send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off, MSG_NOSIGNAL);
+            if (w > 0) { c.out_off += w; continue; }
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;   // EPOLLOUT resumes it
+            close_conn(loop, id);
+            return;
+        }
+        c.out.clear();
+        c.out_off = 0;
+        if (c.close_after && !c.busy) close_conn(loop, id);
+    }
+
+    /* next command from c.in[c.pos..): 1 = `args` filled (empty for a blank inline line),
+       0 = incomplete, -1 = malformed; a multi-bulk request is only consumed once it is complete */
+    int parse(Conn &c, Args &args) {
+        const std::string &in = c.in;
+        size_t p = c.pos;
+        if (p >= in.size()) return 0;
+        if (in[p] != '*') {                                 // inline command, split on blanks
+            size_t nl = in.find('\n', p);
+            if (nl == std::string::npos) return in.size() - p > RESP_MAX_INLINE ? -1 : 0;
+            size_t end = nl > p && in[nl - 1] == '\r' ? nl - 1 : nl;
+            for (size_t i = p; i < end;) {
+                while (i < end && (in[i] == ' ' || in[i] == '\t')) i++;
+                size_t j = i;
+                while (j < end && in[j] != ' ' && in[j] != '\t') j++;
+                if (j > i) args.emplace_back(in, i, j - i);
+                i = j;
+            }
+            c.pos = nl + 1;
+            return 1;
+        }
+        long count;
+        int r = number(in, p, count);
+        if (r <= 0) return r;
+        if (count > RESP_MAX_ARGS) return -1;
+        args.reserve(std::max(0L, std::min(count, 1024L)));          // the count is the client's word, grow past that as args arrive
+        for (long i = 0; i < count; i++) {
+            if (p >= in.size()) return 0;
+            if (in[p] != '$') return -1;
+            long len;
+            if ((r = number(in, p, len)) <= 0) return r;
+            if (len < 0 || (size_t)len > RESP_MAX_BULK) return -1;
+            if (in.size() - p < (size_t)len + 2) return 0;
+            if (in[p + len] != '\r' || in[p + len + 1] != '\n') return -1;
+            args.emplace_back(in, p, len);
+            p += len + 2;
+        }
+        c.pos = p;
+        return 1;
+    }
+
+    // "<type char><decimal>\r\n" at in[p], p moves past it
+    static int number(const std::string &in, size_t &p, long &value) {
+        size_t nl = in.find("\r\n", p + 1);
+        if (nl == std::string::npos) return in.size() - p > 32 ? -1 : 0;
+        char *end = nullptr;
+        value = strtol(in.c_str() + p + 1, &end, 10);
+        if (end != in.c_str() + nl || nl == p + 1) return -1;
+        p = nl + 2;
+        return 1;
+    }
+
+    // commands that never reach the store, and with `hits` GETs the cache answers; false = needs a worker
+    bool local(const Args &args, std::string &out, bool &close, bool hits) {
+        std::string name = upper(args[0]);
+        size_t argc = args.size();
+        if (name == "PING") {
+            if (argc == 1) out += "+PONG\r\n";
+            else bulk(out, args[1]);
+        } else if (name == "QUIT") {
+            out += "+OK\r\n";
+            close = true;
+        } else if (name == "COMMAND" || name == "CONFIG") {
+            out += "*0\r\n";                                // no introspection, the tools carry on without it
+        } else if ((name == "GET" && argc != 2) || (name == "SET" && argc != 3) ||
+                   ((name == "DEL" || name == "MGET") && argc < 2)) {
+            out += "-ERR wrong number of arguments for '" + args[0] + "' command\r\n";
+        } else if (name == "GET" || name == "SET" || name == "DEL" || name == "MGET") {
+            std::shared_ptr<const std::string> value;
+            if (!hits || name != "GET" || !cmds_.hit || !cmds_.hit(args[1], value)) return false;
+            bulk(out, *value);
+        } else {
+            out += "-ERR unknown command '" + args[0] + "'\r\n";
+        }
+        return true;
+    }
+
+    // worker side: any command
+    void execute(const Args &args, std::string &out, bool &close) {
+        if (local(args, out, close, false)) return;
+        std::string name = upper(args[0]);
+        httplib::Response res;
+        if (name == "GET") {
+            cmds_.get(args[1], res);
+            value_reply(out, res.status, SharedBody::of(res));
+        } else if (name == "MGET") {
+            out += "*" + std::to_string(args.size() - 1) + "\r\n";
+            if (cmds_.get_many) {
+                std::vector<std::pair<int, std::string>> replies;
+                cmds_.get_many(std::vector<std::string>(args.begin() + 1, args.end()), replies);
+                for (auto &r : replies) value_reply(out, r.first, r.second);
+                return;
+            }
+            for (size_t i = 1; i < args.size(); i++) {
+                httplib::Response r;
+                cmds_.get(args[i], r);
+                value_reply(out, r.status, SharedBody::of(r));
+            }
+        } else if (name == "SET") {
+            cmds_.set(args[1], args[2], res);
+            if (ok(res.status)) out += "+OK\r\n";
+            else error_reply(out, res.status, res.body);
+        } else {                                            // DEL
+            std::vector<std::pair<int, std::string>> replies;
+            if (cmds_.del_many) {
+                cmds_.del_many(std::vector<std::string>(args.begin() + 1, args.end()), replies);
+            } else {
+                for (size_t i = 1; i < args.size(); i++) {
+                    httplib::Response r;
+                    cmds_.del(args[i], r);
+                    replies.emplace_back(r.status, r.body);
+                }
+            }
+            long deleted = 0;
+            for (auto &r : replies) {
+                if (ok(r.first)) deleted++;
+                else if (r.first != 404) { error_reply(out, r.first, r.second); return; }
+            }
+            out += ":" + std::to_string(deleted) + "\r\n";
+        }
+    }
+
+    static bool ok(int status) { return status == -1 || status == 200; }
+
+    static void value_reply(std::string &out, int status, const std::string &body) {
+        if (ok(status)) bulk(out, body);
+        else if (status == 404) out += "$-1\r\n";
+        else error_reply(out, status, body);
+    }
+
+    static void bulk(std::string &out, const std::string &value) {
+        out += "$" + std::to_string(value.size()) + "\r\n";
+        out += value;
+        out += "\r\n";
+    }
+
+    // 503 (circuit breaker, write queue full) and 500 (store error) as a one-line error reply
+    static void error_reply(std::string &out, int status, const std::string &body) {
+        std::string msg = status == 503 ? "storage unavailable, only cached keys are served" : body;
+        if (msg.empty()) msg = httplib::status_message(status);
+        for (char &ch : msg) if (ch == '\r' || ch == '\n') ch = ' ';
+        while (!msg.empty() && msg.back() == ' ') msg.pop_back();
+        out += "-ERR " + msg + "\r\n";
+    }
+
+    static std::string upper(std::string s) {
+        for (char &ch : s) ch = toupper((unsigned char)ch);
+        return s;
+    }
+
+    static void watch(Loop &loop, int fd, uint64_t id, uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = id;
+        epoll_ctl(loop.epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    static void notify(Loop &loop) {
+        uint64_t one = 1;
+        if (write(loop.wake_fd, &one, sizeof(one)) < 0) {}  // a full counter still wakes the loop
+    }
+
+    void close_conn(Loop &loop, uint64_t id) {
+        auto it = loop.conns.find(id);
+        if (it == loop.conns.end()) return;
+        close(it->second->fd);
+        loop.conns.erase(it);                               // a reply still with a worker is dropped in finish()
+        open_--;
+    }
+
+    void close_loop(Loop &loop) {
+        for (auto &c : loop.conns) close(c.second->fd);
+        loop.conns.clear();
+        for (int fd : {loop.listen_fd, loop.epfd, loop.wake_fd})
+            if (fd >= 0) close(fd);
+        loop.listen_fd = loop.epfd = loop.wake_fd = -1;
+    }
+
+    WorkerPool &pool_;
+    RespCommands cmds_;
+    const int loop_count_;
+    std::vector<std::unique_ptr<Loop>> loops_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<long> open_{0}, accepted_{0}, commands_{0}, on_loop_{0}, tasks_{0}, bad_{0}, rejected_{0};
+};
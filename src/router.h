@@ -0,0 +1,92 @@
+#pragma once
+/*=============================================================
+        Regex-free routing table for the server's fixed endpoints
+ ===============================================================
+ httplib matches every request against the registered patterns with
+ std::regex_match, one pattern after the other, so a GET of a key pays for
+ a regex run per route tried before the right one. The patterns server.cpp
+ registers are all of two shapes, a literal path ("/stats") or a literal
+ prefix followed by one "(.+)" capture ("/table_key_value/(.+)"), and this
+ table matches exactly those shapes without a regex:
+  - literal paths: one hash lookup in the method's table
+  - prefixes: compared byte by byte, longest first, the rest of the path
+    (non-empty, like ".+") is the capture, a string_view into the path
+ find() allocates nothing. add() refuses any other pattern, the caller
+ keeps such a route on its regex matcher.
+================================================================*/
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include "httplib.h"
+
+class Router {
+public:
+    using Handler = httplib::Server::Handler;
+
+    // false if `pattern` is neither a literal path nor a literal prefix + "(.+)", or the method is not routed here
+    bool add(const std::string &method, const std::string &pattern, Handler handler) {
+        int m = method_index(method);
+        if (m < 0) return false;
+        Table &t = tables_[m];
+        const std::string capture = "(.+)";
+        bool prefix = pattern.size() > capture.size() && pattern.compare(pattern.size() - capture.size(), capture.size(), capture) == 0;
+        std::string literal = prefix ? pattern.substr(0, pattern.size() - capture.size()) : pattern;
+        if (literal.empty() || literal[0] != '/' || literal.find_first_of("\\^$.|?*+()[]{}") != std::string::npos) return false;
+        if (!prefix) {
+            t.exact[literal] = std::move(handler);
+            return true;
+        }
+        t.prefixes.push_back(Prefix{literal, std::move(handler)});
+        std::stable_sort(t.prefixes.begin(), t.prefixes.end(),
+                         [](const Prefix &a, const Prefix &b) { return a.literal.size() > b.literal.size(); });
+        return true;
+    }
+
+    // handler registered for method + path or nullptr; `capture` (optional) receives the "(.+)" part
+    const Handler *find(const std::string &method, const std::string &path, std::string_view *capture = nullptr) const {
+        int m = method_index(method);
+        if (m < 0) return nullptr;
+        const Table &t = tables_[m];
+        if (!t.exact.empty()) {
+            auto it = t.exact.find(path);
+            if (it != t.exact.end()) {
+                if (capture) *capture = std::string_view();
+                return &it->second;
+            }
+        }
+        for (const Prefix &p : t.prefixes) {
+            if (path.size() <= p.literal.size() || memcmp(path.data(), p.literal.data(), p.literal.size()) != 0) continue;
+            if (capture) *capture = std::string_view(path).substr(p.literal.size());
+            return &p.handler;
+        }
+        return nullptr;
+    }
+
+private:
+    struct Prefix {
+        std::string literal;
+        Handler handler;
+    };
+
+    struct Table {
+        std::unordered_map<std::string, Handler> exact;
+        std::vector<Prefix> prefixes;            // longest literal first
+    };
+
+    // GET, POST, PUT, DELETE, PATCH: the length and first letter tell them apart
+    static int method_index(const std::string &method) {
+        switch (method.size()) {
+        case 3: return method == "GET" ? 0 : method == "PUT" ? 2 : -1;
+        case 4: return method == "POST" ? 1 : -1;
+        case 5: return method == "PATCH" ? 4 : -1;
+        case 6: return method == "DELETE" ? 3 : -1;
+        default: return -1;
+        }
+    }
+
+    std::array<Table, 5> tables_;
+};
@@ -5,110 +5,486 @@
 #include <sstream>
 #include <iomanip>
 #include <atomic>
+#include <array>
+#include <map>
+#include <chrono>
+#include <memory>
+#include <future>
+#include <unistd.h>
 #include "httplib.h"
-#include <mysql/mysql.h>
+#include "kv_store.h"
+#include "mysql_store.h"
+#include "bitcask.h"
+#include "lsm.h"
+#include "key_filter.h"
+#include "circuit_breaker.h"
+#include "latency.h"
+#include "write_behind.h"
+#include "prefetcher.h"
+#include "worker_pool.h"
+#include "event_server.h"
+#include "resp_server.h"
+#include "router.h"
 
 
 using namespace std;
 constexpr size_t CACHE_CAPACITY = 5000; //max capacity of cache
+constexpr size_t BULK_BATCH_BYTES = 4 << 20; //bulk ingest: records handed to the store per batch
+constexpr int HTTP_PORT = 8080;
+constexpr int HTTPLIB_SIDE_PORT = 8081;       //--frontend=epoll|uring: httplib keeps serving every route (bulk ingest) here
+constexpr size_t BATCH_MAX_KEYS = 10000;      //keys (or pairs) one /mget, /mput or /mdelete request may carry
+const string KV_PREFIX = "/table_key_value/";  //routes below are KV_PREFIX + "(.+)", the key is the rest of the path
 
 
 
 
 /*=============================================================
-                        MySQL connecting
- ===============================================================*/
-MYSQL* connect_db() {
-    // Initialize a new MySQL connection handle, mysql_init() prepares a connection object for further use.
-    MYSQL *conn = mysql_init(nullptr);
-    if (!conn) return nullptr; // If initialization failed, return null (connection object invalid).
-
-    /* Try connecting to the MySQL server using provided credentials:
-    - Host: 127.0.0.1  (local machine)
-    - User: user_744
-    - Password: key_744
-    - Database: key_value_DB_744
-    - Port: 0 (default MySQL port 3306 will be used)
-    - Socket and client flags set to nullptr and 0 */
-    if (!mysql_real_connect(conn, "127.0.0.1", "user_744", "key_744", "key_value_DB_744", 0, nullptr, 0)) {
-        cerr << "MySQL connection failed: " << mysql_error(conn) << endl; // If connection fails, print an error message from MySQL.
-        mysql_close(conn);// Close and free the connection handle to avoid leaks.
-        return nullptr; // Return nullptr to indicate failure to caller.
-    }
-
-    // Create the key-value table if it doesn’t already exist. with - `k`: VARCHAR(255) used as the key (PRIMARY KEY ensures uniqueness) 
-    mysql_query(conn, "CREATE TABLE IF NOT EXISTS key_value_table (k VARCHAR(255) PRIMARY KEY, v TEXT)");
-    return conn;// Return the valid connection object to the caller, This will be used throughout the program to perform SQL operations.
+                 command line configuration
+ ===============================================================
+ ./bin/server [--backend=mysql|bitcask|lsm] [--data-dir=<path>] [--sync=0|1]
+              [--key-filter=0|1] [--filter-capacity=<keys>]
+              [--db-io-threads=<n>] [--db-conns=<per thread>]
+              [--partitions=<n>] [--db-hosts=<host:port,...>]
+              [--db-timeout-ms=<ms>] [--breaker=0|1] [--breaker-slow-ms=<ms>]
+              [--binlog=0|1] [--binlog-server-id=<id>]
+              [--async-flush-ms=<ms>] [--async-max-pending=<keys>]
+              [--miss-batch-us=<us>] [--miss-batch-max=<keys>] [--hedge-percentile=<p>]
+              [--eviction=lru|gds] [--prefetch=0|1] [--prefetch-block=<keys>]
+              [--prefetch-capacity=<entries>]
+              [--workers=<n>] [--max-queue=<connections>] [--pin-workers=0|1]
+              [--scheduler=stealing|shared] [--frontend=httplib|epoll|uring]
+              [--event-loops=<n>] [--shards=<n>] [--resp-port=<port>]
+================================================================*/
+struct ServerConfig {
+    string backend = "mysql";          // storage tier behind the cache
+    string data_dir = "data";          // root directory for the embedded engines
+    bool sync_writes = true;           // embedded engines: fdatasync (group commit) before acknowledging writes
+    bool key_filter = true;            // counting bloom filter in front of the store for GET misses
+    uint64_t filter_capacity = 1000000;// keys the filter is sized for (grown to the table's row estimate)
+    int db_io_threads = 2;             // mysql: event-loop threads driving the non-blocking connections
+    int db_conns = 8;                  // mysql: connections owned by each of those threads (per endpoint)
+    int partitions = 1;                // mysql: key_value_table_<p> tables the keys are hashed over
+    vector<DBEndpoint> db_hosts;       // mysql: mysqld instances the partitions are spread over (default 127.0.0.1)
+    int db_timeout_ms = 2000;          // mysql: deadline of one statement, also bounds connect / blocking reads
+    bool breaker = true;               // stop calling the store while it keeps failing or stalling
+    BreakerOptions breaker_opts;
+    bool binlog = false;               // mysql: follow the binary log to see writes made by other processes
+    uint32_t binlog_server_id = 7440000 + getpid() % 10000;   // replica id, must be unique per server instance
+    WriteBehindOptions write_behind;   // queue behind "X-Durability: async" writes
+    int miss_batch_us = 0;             // mysql: gather concurrent GET misses this long into one IN-list query (0 = off)
+    int miss_batch_max = 128;          // mysql: keys per IN list, a full batch does not wait for the window
+    double hedge_percentile = 0;       // mysql: duplicate a read still unanswered at this latency percentile (0 = off)
+    bool gds_eviction = false;         // cache: evict by GreedyDual miss cost instead of recency
+    bool prefetch = false;             // read ahead when GETs walk numbered keys in order
+    PrefetchOptions prefetch_opts;
+    size_t prefetch_capacity = 1024;   // cache: low-priority entries prefetched but not read yet
+    WorkerPoolOptions pool;            // threads serving HTTP connections, their queue limit and CPU pinning
+    string frontend = "httplib";       // epoll / uring: event loops own the key-value port, workers only run complete requests
+    int event_loops = thread::hardware_concurrency();
+    int shards = 1;                    // cache slices; >1: one pinned event loop per slice answering its cache hits (0 = one per core)
+    int resp_port = 0;                 // Redis protocol (GET/SET/DEL/MGET) listener, 0 = off
+};
+
+void usage() {
+    cerr << "Usage: ./server [--backend=mysql|bitcask|lsm] [--data-dir=<path>] [--sync=0|1]\n"
+         << "                [--key-filter=0|1] [--filter-capacity=<keys>]\n"
+         << "                [--db-io-threads=<n>] [--db-conns=<per thread>]\n"
+         << "                [--partitions=<n>] [--db-hosts=<host:port,...>]\n"
+         << "                [--db-timeout-ms=<ms>] [--breaker=0|1] [--breaker-slow-ms=<ms>]\n"
+         << "                [--binlog=0|1] [--binlog-server-id=<id>]\n"
+         << "                [--async-flush-ms=<ms>] [--async-max-pending=<keys>]\n"
+         << "                [--miss-batch-us=<us>] [--miss-batch-max=<keys>] [--hedge-percentile=<p>]\n"
+         << "                [--eviction=lru|gds] [--prefetch=0|1] [--prefetch-block=<keys>]\n"
+         << "                [--prefetch-capacity=<entries>]\n"
+         << "                [--workers=<n>] [--max-queue=<connections>] [--pin-workers=0|1]\n"
+         << "                [--scheduler=stealing|shared] [--frontend=httplib|epoll|uring]\n"
+         << "                [--event-loops=<n>] [--shards=<n>] [--resp-port=<port>]\n";
 }
 
-// function to escape single quotes in SQL strings, Prevents SQL injection or syntax errors by escaping `'` as `\'`.
-string escape_sql(const string &s) {
-    string out;
-    for (char c : s)        // Iterate through every character in the input string.
-        out += (c == '\'' ? "\\'" : string(1, c));   // If the character is a single quote ('), append an escaped version.
-    return out;  // Return the sanitized SQL-safe string.
+bool parse_args(int argc, char *argv[], ServerConfig &cfg) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == string::npos) { usage(); return false; }
+        string name = arg.substr(2, eq - 2), value = arg.substr(eq + 1);
+        if (name == "backend") cfg.backend = value;
+        else if (name == "data-dir") cfg.data_dir = value;
+        else if (name == "sync") cfg.sync_writes = (value != "0");
+        else if (name == "key-filter") cfg.key_filter = (value != "0");
+        else if (name == "filter-capacity") cfg.filter_capacity = stoull(value);
+        else if (name == "db-io-threads") cfg.db_io_threads = stoi(value);
+        else if (name == "db-conns") cfg.db_conns = stoi(value);
+        else if (name == "partitions") cfg.partitions = stoi(value);
+        else if (name == "db-timeout-ms") cfg.db_timeout_ms = stoi(value);
+        else if (name == "breaker") cfg.breaker = (value != "0");
+        else if (name == "breaker-slow-ms") cfg.breaker_opts.slow_ms = stoi(value);
+        else if (name == "binlog") cfg.binlog = (value != "0");
+        else if (name == "binlog-server-id") cfg.binlog_server_id = stoul(value);
+        else if (name == "async-flush-ms") cfg.write_behind.flush_ms = stoi(value);
+        else if (name == "async-max-pending") cfg.write_behind.max_pending = stoull(value);
+        else if (name == "miss-batch-us") cfg.miss_batch_us = stoi(value);
+        else if (name == "miss-batch-max") cfg.miss_batch_max = stoi(value);
+        else if (name == "hedge-percentile") cfg.hedge_percentile = stod(value);
+        else if (name == "eviction" && (value == "lru" || value == "gds")) cfg.gds_eviction = (value == "gds");
+        else if (name == "prefetch") cfg.prefetch = (value != "0");
+        else if (name == "prefetch-block") cfg.prefetch_opts.block = stoi(value);
+        else if (name == "prefetch-capacity") cfg.prefetch_capacity = stoull(value);
+        else if (name == "workers") cfg.pool.workers = stoi(value);
+        else if (name == "max-queue") cfg.pool.max_queue = stoull(value);
+        else if (name == "pin-workers") cfg.pool.pin = (value != "0");
+        else if (name == "scheduler" && (value == "stealing" || value == "shared")) cfg.pool.stealing = (value == "stealing");
+        else if (name == "frontend" && (value == "httplib" || value == "epoll" || value == "uring")) cfg.frontend = value;
+        else if (name == "event-loops") cfg.event_loops = stoi(value);
+        else if (name == "shards") cfg.shards = stoi(value);
+        else if (name == "resp-port") cfg.resp_port = stoi(value);
+        else if (name == "db-hosts") {
+            stringstream list(value);
+            for (string item; getline(list, item, ',');) {
+                DBEndpoint ep;
+                size_t colon = item.rfind(':');
+                ep.host = item.substr(0, colon);
+                if (colon != string::npos) ep.port = stoul(item.substr(colon + 1));
+                cfg.db_hosts.push_back(ep);
+            }
+        }
+        else { cerr << "Unknown option: " << arg << "\n"; usage(); return false; }
+    }
+    if (cfg.shards <= 0) cfg.shards = max(1u, thread::hardware_concurrency());
+    if (cfg.shards > 1) {                                  // shard-per-core needs the event loops, one per slice
+        if (cfg.frontend == "httplib") cfg.frontend = "epoll";
+        cfg.event_loops = cfg.shards;
+    }
+    return true;
+}
+
+// stream every key of the store into `filter`, false if the backend cannot list its keys
+// `binlog`: its tailers (started with a held mark) keep the filter up to date, the scan has to start after their
+// streams and the mark goes to the end of the binlog once it is done, see the binlog callback in main()
+bool load_key_filter(CountingBloomFilter &filter, KVStore &store, MySQLStore *binlog, const ServerConfig &cfg) {
+    auto t0 = chrono::steady_clock::now();
+    string error;
+    long loaded = 0;
+    bool ok = !binlog || binlog->binlog_streaming(chrono::milliseconds(cfg.db_timeout_ms * 4));
+    if (!ok) error = "binlog tailer not streaming";
+    ok = ok && store.scan_keys([&](const string &key) { filter.add(key); loaded++; }, error);
+    ok = ok && (!binlog || binlog->mark_binlog(error));
+    if (!ok) {
+        cerr << "Key filter disabled: " << error << "\n";
+        return false;
+    }
+    cout << "Key filter built from " << loaded << " keys in "
+         << chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - t0).count() << " ms\n";
+    return true;
+}
+
+// build and open the storage tier selected by --backend
+unique_ptr<KVStore> open_store(const ServerConfig &cfg, string &error) {
+    if (cfg.backend == "mysql") {
+        auto s = make_unique<MySQLStore>(cfg.db_hosts, cfg.partitions, cfg.db_io_threads, cfg.db_conns, cfg.db_timeout_ms);
+        s->enable_miss_batching(cfg.miss_batch_us, cfg.miss_batch_max);
+        s->enable_hedging(cfg.hedge_percentile);
+        if (!s->open(error)) return nullptr;
+        return s;
+    }
+    if (cfg.backend == "bitcask") {
+        BitcaskOptions opts;
+        opts.dir = cfg.data_dir + "/bitcask";
+        opts.sync_writes = cfg.sync_writes;
+        auto s = make_unique<BitcaskStore>(opts);
+        if (!s->open(error)) return nullptr;
+        return s;
+    }
+    if (cfg.backend == "lsm") {
+        LSMOptions opts;
+        opts.dir = cfg.data_dir + "/lsm";
+        opts.sync_writes = cfg.sync_writes;
+        auto s = make_unique<LSMStore>(opts);
+        if (!s->open(error)) return nullptr;
+        return s;
+    }
+    error = "unknown backend '" + cfg.backend + "'";
+    return nullptr;
+}
+
+
+
+
+// fast answer for requests that need the store while the circuit breaker is open
+void reply_unavailable(httplib::Response &response) {
+    response.status = 503;
+    response.set_header("Retry-After", "1");
+}
+
+// X-Durability header of PUT/POST/DELETE: how far a write has to get before it is acknowledged
+//   none  → cache only (lost on eviction or restart, for data the client can recompute)
+//   async → cache + write-behind queue, flushed to the store in batches within a few ms
+//   sync  → written through to the store first (default, the behavior without the header)
+enum Durability { DURABILITY_NONE, DURABILITY_ASYNC, DURABILITY_SYNC, DURABILITY_LEVELS };
+const char *const DURABILITY_NAMES[DURABILITY_LEVELS] = {"none", "async", "sync"};
+
+bool parse_durability(const httplib::Request &request, Durability &level) {
+    string h = request.get_header_value("X-Durability");
+    if (h.empty()) { level = DURABILITY_SYNC; return true; }
+    for (int i = 0; i < DURABILITY_LEVELS; i++)
+        if (h == DURABILITY_NAMES[i]) { level = (Durability)i; return true; }
+    return false;
+}
+
+void reply_bad_durability(httplib::Response &response) {
+    response.status = 400;
+    response.set_content("X-Durability must be none, async or sync\n", "text/plain");
+}
+
+// appends `"name": section` as the last member of the JSON object in `json`
+void append_stats_section(string &json, const string &name, const string &section) {
+    json.erase(json.find_last_of('}'));
+    while (!json.empty() && isspace((unsigned char)json.back())) json.pop_back();
+    json += ",\n  \"" + name + "\": " + section + "\n}";
+}
+
+void reply_bad_batch(httplib::Response &response) {
+    response.status = 400;
+    response.set_content("Batch body must hold 1 to " + to_string(BATCH_MAX_KEYS) +
+                         " lines: keys (/mget, /mdelete) or key<TAB>value (/mput)\n", "text/plain");
+}
+
+// key of a /table_key_value/<key> request, read off the path so it works without regex matches (Router, pre-routing)
+string kv_key(const httplib::Request &request) {
+    return request.path.compare(0, KV_PREFIX.size(), KV_PREFIX) == 0 ? request.path.substr(KV_PREFIX.size()) : string();
 }
 
+// (status, body) per key of a batch request, in request order
+using BatchReplies = vector<pair<int, string>>;
+
+// /mget and /mdelete bodies: one key per line, blank lines skipped
+bool parse_batch_keys(const string &body, vector<string> &keys) {
+    for (size_t start = 0; start < body.size();) {
+        size_t nl = body.find('\n', start);
+        if (nl == string::npos) nl = body.size();
+        size_t end = (nl > start && body[nl - 1] == '\r') ? nl - 1 : nl;
+        if (end > start) keys.emplace_back(body, start, end - start);
+        start = nl + 1;
+    }
+    return !keys.empty() && keys.size() <= BATCH_MAX_KEYS;
+}
+
+// /mput body: "key<TAB>value" lines, the /bulk_ingest record format
+bool parse_batch_pairs(const string &body, vector<pair<string, string>> &kvs) {
+    for (size_t start = 0; start < body.size();) {
+        size_t nl = body.find('\n', start);
+        if (nl == string::npos) nl = body.size();
+        size_t end = (nl > start && body[nl - 1] == '\r') ? nl - 1 : nl;
+        if (end > start) {
+            size_t tab = body.find('\t', start);
+            if (tab == string::npos || tab >= end || tab == start) return false;
+            kvs.emplace_back(body.substr(start, tab - start), body.substr(tab + 1, end - tab - 1));
+        }
+        start = nl + 1;
+    }
+    return !kvs.empty() && kvs.size() <= BATCH_MAX_KEYS;
+}
 
+// batch response framing: "<status> <body length> <key>\n<body>\n" per key, body = the value (or error text)
+string frame_batch(const vector<string> &keys, const BatchReplies &replies) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < keys.size(); i++) bytes += keys[i].size() + replies[i].second.size() + 16;
+    string out;
+    out.reserve(bytes);
+    for (size_t i = 0; i < keys.size(); i++) {
+        out += to_string(replies[i].first);
+        out += ' ';
+        out += to_string(replies[i].second.size());
+        out += ' ';
+        out += keys[i];
+        out += '\n';
+        out += replies[i].second;
+        out += '\n';
+    }
+    return out;
+}
 
 
 
 
 /*=============================================================
                          LRU cache
+ ===============================================================
+ Entries carry the store's version of their value. GET-miss fills and PUTs
+ run without any lock around the store call, so their cache updates can
+ arrive out of order; put_if_newer() only installs a value that is newer
+ than the cached one. For a key that is not cached, the generation of its
+ stripe (bumped by every erase and eviction in the stripe) taken before the
+ store call tells whether the key was deleted or evicted meanwhile, in which
+ case the value may be stale and is not installed.
+
+ Writes acknowledged before they reached the store (X-Durability none or
+ async) are put_local(): they have no store version yet, so the entry is
+ marked local and only another write (or a newer binlog change) replaces it,
+ never a GET-miss fill. A synchronous write only replaces it when its stripe
+ did not move since the write's ticket, otherwise the local entry may be the
+ newer of the two and is dropped instead.
+
+ Eviction is LRU by default. With gds = true it is GreedyDual: every entry
+ has a priority H = L + cost, where cost is the time the store took to
+ fetch it on its last miss, and H is renewed on every hit. The entry with
+ the lowest H goes, and L rises to that H, so entries that are not used
+ age out even when they were expensive. Entries that came in through a
+ write have no measured cost; they are charged the average miss cost
+ scaled by their size against the average fetched size, since larger
+ rows take longer to read back. The result is less total time spent on
+ misses rather than fewer misses.
+
+ Prefetched entries (put_prefetched()) wait in a separate probation list
+ of prefetch_capacity entries that evicts only among themselves, so read
+ ahead never pushes out keys that were actually requested. The first hit
+ promotes an entry to the main list like any other MRU entry.
 ================================================================*/
 class LRUCache {
 public:
-    explicit LRUCache(size_t capacity) : capacity_(capacity) {} // Constructor — initialize the cache with a maximum capacity.
+    explicit LRUCache(size_t capacity, bool gds = false, size_t prefetch_capacity = 0) // Constructor — initialize the cache with a maximum capacity.
+        : capacity_(capacity), gds_(gds), prefetch_capacity_(prefetch_capacity) {}
 
 
-    // GET from cache
-    bool get(const string &key, string &value) {
+    // GET from cache, `prefetched` (optional) tells whether the hit was a prefetched entry read for the first time
+    // count_miss = false: a miss is not counted, the caller looks again later (shard fast path)
+    bool get(const string &key, string &value, bool *prefetched = nullptr, bool count_miss = true) {
+        shared_ptr<const string> v;
+        if (!get_shared(key, v, prefetched, count_miss)) return false;
+        value = *v;                         // copied outside the cache mutex
+        return true;
+    }
+
+
+    // GET without a copy: `value` shares the cached buffer, which stays valid after a later update or eviction
+    // (updates install a new buffer, they never write into one a reader may hold)
+    bool get_shared(const string &key, shared_ptr<const string> &value, bool *prefetched = nullptr, bool count_miss = true) {
         lock_guard<mutex> lg(mu_);          // cache mutex
-        get_requests_++;                    // Increment GET operation count declared in private
-        total_requests_++;                  // Increment total requests count (all types)
         auto it = map_.find(key);                        // Try to find the key in the hashmap
+        if (it != map_.end() || count_miss) {
+            get_requests_++;                // Increment GET operation count declared in private
+            total_requests_++;              // Increment total requests count (all types)
+        }
         if (it == map_.end()) {             // Not found → cache miss
+            if (!count_miss) return false;
             get_misses_++;                  // Increment GET misses
             total_misses_++;                // Increment total misses
             return false;                   // Indicate cache miss
         }
-        items_.splice(items_.begin(), items_, it->second); // Found in cache → move the accessed item to front of LRU list (most recently used)
-        value = it->second->second;         // Extract the value associated with this key or callers variable
+        if (prefetched) *prefetched = it->second->probation;
+        touch(it->second);                  // Found in cache → move the accessed item to front of LRU list (most recently used)
+        value = it->second->value;          // Extract the value associated with this key or callers variable
         get_hits_++;                        // Increment GET hit count
         total_hits_++;                      // Increment total hit count
         return true;                        // Indicate success
     }
 
 
-    // PUT/POST — insert or update in cache
-    void put(const string &key, const string &value) {
+    // generation of the key's stripe, taken before the store call whose result will be put_if_newer()'d
+    uint64_t fill_ticket(const string &key) const {
+        lock_guard<mutex> lg(mu_);          // cache mutex
+        return gens_[stripe(key)];
+    }
+
+
+    // PUT/POST (is_write) and GET-miss fill — insert or update in cache unless the cache already knows something newer
+    // a fill passes how long the store took to fetch the value (miss_cost_us), the GDS cost of the entry
+    bool put_if_newer(const string &key, const string &value, uint64_t version, uint64_t ticket, bool is_write = false,
+                      double miss_cost_us = 0) {
+        lock_guard<mutex> lg(mu_);          // cache mutex
+        if (miss_cost_us > 0) note_miss_cost(miss_cost_us, key.size() + value.size());
+        auto it = map_.find(key);
+        if (it != map_.end()) {             // If key already exists → update value (only forward) and move to front
+            bool local = it->second->local; // a local entry borrowed its version, a store write replaces it...
+            if (local ? !is_write : it->second->version >= version) { stale_fills_++; return false; }
+            if (local && gens_[stripe(key)] != ticket) {
+                // ...unless it may have been put_local()'d after this write began: that one is newer and its queued
+                // write lands after this one. Which came first is unknown here, so neither is cached; a GET reads
+                // the queued write or the store
+                gens_[stripe(key)]++;
+                drop(it->second);
+                stale_fills_++;
+                return false;
+            }
+            it->second->value = make_shared<const string>(value);
+            it->second->version = version;
+            it->second->local = false;
+            if (miss_cost_us > 0) it->second->cost = miss_cost_us;
+            touch(it->second);
+            return true;
+        }
+        if (gens_[stripe(key)] != ticket) { stale_fills_++; return false; } // erased/evicted since the store call began
+        insert_front(Entry{key, make_shared<const string>(value), version, false,
+                           miss_cost_us > 0 ? miss_cost_us : estimated_cost(key, value)});
+        return true;
+    }
+
+
+    // PUT/POST with X-Durability none/async — the value is not (yet) in the store
+    void put_local(const string &key, const string &value) {
         lock_guard<mutex> lg(mu_);          // cache mutex
+        gens_[stripe(key)]++;               // fills that read the store before this write must not install
         auto it = map_.find(key);
-        if (it != map_.end()) {             // If key already exists → update value and move to front
-            it->second->second = value;
-            items_.splice(items_.begin(), items_, it->second);
+        if (it != map_.end()) {             // keep the version, the next store write or newer change still wins
+            it->second->value = make_shared<const string>(value);
+            it->second->local = true;
+            touch(it->second);
             return;
         }
-        // If cache is full → remove LRU (back of list)
-        if (items_.size() >= capacity_) {
-            const auto &last = items_.back();
-            map_.erase(last.first);         // Erase from map
-            items_.pop_back();              // Remove from list
+        insert_front(Entry{key, make_shared<const string>(value), 0, true, estimated_cost(key, value)});
+    }
+
+
+    // read-ahead result: goes to the probation list, only if the key is not cached and nothing changed it meanwhile
+    bool put_prefetched(const string &key, const string &value, uint64_t version, uint64_t ticket) {
+        lock_guard<mutex> lg(mu_);          // cache mutex
+        if (!prefetch_capacity_ || map_.count(key) || gens_[stripe(key)] != ticket) return false;
+        if (prefetched_.size() >= prefetch_capacity_) {
+            auto victim = prev(prefetched_.end());
+            gens_[stripe(victim->key)]++;
+            drop(victim);
+            prefetch_wasted_++;             // read ahead for nothing
+        }
+        prefetched_.push_front(Entry{key, make_shared<const string>(value), version, false, estimated_cost(key, value)});
+        prefetched_.front().probation = true;
+        map_[key] = prefetched_.begin();
+        return true;
+    }
+
+
+    // change seen in the store by someone else (binlog): newer versions replace the cached value,
+    // an entry the event cannot be ordered against is dropped, a key that is not cached only bumps its stripe
+    void apply_remote(const string &key, const string *value, uint64_t version) {
+        lock_guard<mutex> lg(mu_);          // cache mutex
+        gens_[stripe(key)]++;               // a fill that read the store before this change must not install
+        auto it = map_.find(key);
+        if (it == map_.end()) return;
+        if (value && version > it->second->version) {
+            it->second->value = make_shared<const string>(*value);
+            it->second->version = version;
+            it->second->local = false;
+        } else if (!value || *it->second->value != *value) {   // delete, or a writer that did not bump `ver`
+            drop(it->second);
         }
-        // Insert new key-value pair at the front (MRU)
-        items_.emplace_front(key, value);
-        map_[key] = items_.begin();         // Point map entry to list node
+    }
+
+    // forget everything (changes may have been missed)
+    void clear() {
+        lock_guard<mutex> lg(mu_);          // cache mutex
+        for (auto &g : gens_) g++;
+        items_.clear();
+        prefetched_.clear();
+        map_.clear();
+        by_priority_.clear();
     }
 
 
     // DELETE — remove from cache if exists
     void erase(const string &key) {
         lock_guard<mutex> lg(mu_);          // cache mutex
+        gens_[stripe(key)]++;               // fills that read the store before the delete must not resurrect the key
         auto it = map_.find(key);
         if (it != map_.end()) {             // if found in map then
-            items_.erase(it->second);       // Erase from linked list
-            map_.erase(it);                 // Erase from map
+            drop(it->second);               // Erase from linked list and map
         }
     }
 
@@ -130,54 +506,164 @@ public:
         vector<string> ks;
         ks.reserve(items_.size());          // Preallocate memory
         for (const auto &p : items_)        // Traverse linked list 'items_'
-            ks.push_back(p.first);          // Collect keys
+            ks.push_back(p.key);            // Collect keys
         return ks;                          // Return all key names
     }
 
 
-    // cache stats report in JSON 
-    string stats_json() const {
+    // counters behind stats_json(), summed over the slices of a ShardedCache
+    struct Stats {
+        size_t slices = 0, size = 0, capacity = 0, prefetched = 0, prefetch_capacity = 0;
+        long get_requests = 0, get_hits = 0, get_misses = 0, pop_requests = 0, pop_hits = 0, pop_misses = 0;
+        long total_requests = 0, total_hits = 0, total_misses = 0, stale_fills = 0;
+        long evictions = 0, prefetch_hits = 0, prefetch_wasted = 0;
+        double inflation = 0, avg_cost_us = 0, miss_time_us = 0;   // avg_cost_us: summed, divided by slices
+        bool gds = false;
+    };
+    void add_stats(Stats &s) const {
         lock_guard<mutex> lg(mu_);
+        s.slices++;
+        s.size += items_.size();
+        s.capacity += capacity_;
+        s.prefetched += prefetched_.size();
+        s.prefetch_capacity += prefetch_capacity_;
+        s.get_requests += get_requests_; s.get_hits += get_hits_; s.get_misses += get_misses_;
+        s.pop_requests += pop_requests_; s.pop_hits += pop_hits_; s.pop_misses += pop_misses_;
+        s.total_requests += total_requests_; s.total_hits += total_hits_; s.total_misses += total_misses_;
+        s.stale_fills += stale_fills_;
+        s.evictions += evictions_;
+        s.prefetch_hits += prefetch_hits_;
+        s.prefetch_wasted += prefetch_wasted_;
+        s.inflation = max(s.inflation, inflation_);
+        s.avg_cost_us += avg_cost_us_;
+        s.miss_time_us += miss_time_us_;
+        s.gds = gds_;
+    }
 
+    // cache stats report in JSON 
+    static string stats_json(const Stats &s) {
         // to compute the hit ratio
         auto ratio = [](long h, long m){return (h + m == 0) ? 0.0 : (100.0 * h / (double)(h + m));};
        
         stringstream ss; // Build a JSON string manually (no external JSON library)
         ss << fixed << setprecision(2);
         ss << "{\n"
-           << "  \"cache_size\": " << items_.size() << ",\n"        // Current number of items
-           << "  \"cache_capacity\": " << capacity_ << ",\n"        // Max possible capacity
-           << "  \"per_operation\": {\n"
-           << "    \"GET\": {\"requests\": " << get_requests_       // GET stats
-           << ", \"hits\": " << get_hits_
-           << ", \"misses\": " << get_misses_
-           << ", \"hit_ratio\": " << ratio(get_hits_, get_misses_) << "},\n"
-           << "    \"POPULAR\": {\"requests\": " << pop_requests_   // POPULAR stats
-           << ", \"hits\": " << pop_hits_
-           << ", \"misses\": " << pop_misses_
-           << ", \"hit_ratio\": " << ratio(pop_hits_, pop_misses_) << "}\n"
+           << "  \"cache_size\": " << s.size << ",\n"               // Current number of items
+           << "  \"cache_capacity\": " << s.capacity << ",\n";      // Max possible capacity
+        if (s.slices > 1) ss << "  \"cache_shards\": " << s.slices << ",\n";
+        ss << "  \"per_operation\": {\n"
+           << "    \"GET\": {\"requests\": " << s.get_requests     // GET stats
+           << ", \"hits\": " << s.get_hits
+           << ", \"misses\": " << s.get_misses
+           << ", \"hit_ratio\": " << ratio(s.get_hits, s.get_misses) << "},\n"
+           << "    \"POPULAR\": {\"requests\": " << s.pop_requests // POPULAR stats
+           << ", \"hits\": " << s.pop_hits
+           << ", \"misses\": " << s.pop_misses
+           << ", \"hit_ratio\": " << ratio(s.pop_hits, s.pop_misses) << "}\n"
            << "  },\n"
-           << "  \"cumulative\": {\"requests\": " << total_requests_// All ops combined
-           << ", \"hits\": " << total_hits_
-           << ", \"misses\": " << total_misses_
-           << ", \"hit_ratio\": " << ratio(total_hits_, total_misses_) << "}\n"
+           << "  \"cumulative\": {\"requests\": " << s.total_requests // All ops combined
+           << ", \"hits\": " << s.total_hits
+           << ", \"misses\": " << s.total_misses
+           << ", \"hit_ratio\": " << ratio(s.total_hits, s.total_misses) << "},\n"
+           << "  \"stale_fills_rejected\": " << s.stale_fills << ",\n"
+           << "  \"eviction\": {\"policy\": \"" << (s.gds ? "gds" : "lru") << "\", \"evictions\": " << s.evictions
+           << ", \"gds_inflation_us\": " << s.inflation << ", \"avg_miss_cost_us\": " << s.avg_cost_us / max<size_t>(1, s.slices)
+           << ", \"miss_fetch_ms\": " << s.miss_time_us / 1000 << "},\n"
+           << "  \"prefetched\": {\"cached\": " << s.prefetched << ", \"capacity\": " << s.prefetch_capacity
+           << ", \"hits\": " << s.prefetch_hits << ", \"evicted_unused\": " << s.prefetch_wasted << "}\n"
            << "}";
         return ss.str();                                            // Return full JSON string
     }
 
 
 private:
+    struct Entry;
+    using Priorities = multimap<double, list<Entry>::iterator>;
+    struct Entry {
+        string key;
+        shared_ptr<const string> value;      // never modified in place, GET hits may still be sending it
+        uint64_t version;                    // store version of `value`
+        bool local;                          // written with durability none/async, `version` is the one it replaced
+        double cost;                         // GDS: microseconds a miss of this key costs
+        Priorities::iterator prio;           // GDS: position in by_priority_ (main list only)
+        bool probation = false;              // in prefetched_, not requested yet
+    };
+    static size_t stripe(const string &key) { return hash<string>{}(key) % 4096; }
+
+    // new MRU entry, evicting the LRU (or lowest GDS priority) one if the cache is full (caller holds mu_)
+    void insert_front(Entry &&e) {
+        if (items_.size() >= capacity_) evict_one();
+        items_.push_front(std::move(e));    // Insert new entry at the front (MRU)
+        map_[items_.front().key] = items_.begin();   // Point map entry to list node
+        if (gds_) items_.front().prio = by_priority_.emplace(inflation_ + items_.front().cost, items_.begin());
+    }
+
+    void evict_one() {
+        auto victim = prev(items_.end());
+        if (gds_) {
+            victim = by_priority_.begin()->second;
+            inflation_ = by_priority_.begin()->first;   // L: everything cached now is aged against this
+        }
+        gens_[stripe(victim->key)]++;       // an in-flight fill of the evicted key may carry an older value
+        drop(victim);
+        evictions_++;
+    }
+
+    // hit or update: move to the MRU position and renew the GDS priority, a prefetched entry joins the main list
+    void touch(list<Entry>::iterator e) {
+        if (e->probation) {
+            if (items_.size() >= capacity_) evict_one();
+            items_.splice(items_.begin(), prefetched_, e);
+            e->probation = false;
+            prefetch_hits_++;
+            if (gds_) e->prio = by_priority_.emplace(inflation_ + e->cost, e);
+            return;
+        }
+        items_.splice(items_.begin(), items_, e);
+        if (!gds_) return;
+        by_priority_.erase(e->prio);
+        e->prio = by_priority_.emplace(inflation_ + e->cost, e);
+    }
+
+    void drop(list<Entry>::iterator e) {
+        if (gds_ && !e->probation) by_priority_.erase(e->prio);
+        map_.erase(e->key);                 // Erase from map
+        (e->probation ? prefetched_ : items_).erase(e);   // Remove from list
+    }
+
+    // running averages of measured misses, used to charge entries that were never fetched
+    void note_miss_cost(double us, size_t bytes) {
+        miss_time_us_ += us;
+        avg_cost_us_ = avg_cost_us_ ? 0.99 * avg_cost_us_ + 0.01 * us : us;
+        avg_bytes_ = avg_bytes_ ? 0.99 * avg_bytes_ + 0.01 * bytes : bytes;
+    }
+    double estimated_cost(const string &key, const string &value) const {
+        if (!avg_cost_us_) return 1;
+        return avg_cost_us_ * (key.size() + value.size() + 256) / (avg_bytes_ + 256);  // +256: fixed per-row overhead
+    }
+
     size_t capacity_;                        // Max cache size (number of key-value pairs)
+    const bool gds_;                         // GreedyDual eviction instead of LRU
+    size_t prefetch_capacity_;               // size of the probation list, 0 = no prefetching
     mutable mutex mu_;                       // Mutex for thread-safe access
 
     // LRU data structures:
-    list<pair<string, string>> items_;       // Doubly-linked list storing {key, value} pairs, Front = Most Recently Used (MRU), Back = Least Recently Used (LRU)
-    unordered_map<string, list<pair<string, string>>::iterator> map_;// Fast O(1) lookup from key → iterator into list
+    list<Entry> items_;                      // Doubly-linked list storing {key, value, version}, Front = Most Recently Used (MRU), Back = Least Recently Used (LRU)
+    unordered_map<string, list<Entry>::iterator> map_;// Fast O(1) lookup from key → iterator into list
+    array<uint64_t, 4096> gens_{};           // erase/eviction generation per key stripe, see put_if_newer()
+    Priorities by_priority_;                 // GDS: entries by H, lowest evicted first
+    list<Entry> prefetched_;                 // probation list of read-ahead entries, own LRU order
+    long prefetch_hits_ = 0, prefetch_wasted_ = 0;
+    double inflation_ = 0;                   // GDS: L, the H of the last evicted entry
+    double avg_cost_us_ = 0, avg_bytes_ = 0; // moving averages over measured misses
+    double miss_time_us_ = 0;                // total store time spent on misses that filled the cache
+    long evictions_ = 0;
                                              
     // Stats counters — atomic to avoid race conditions for hit,miss etc.. counter updating
     atomic<long> get_hits_{0}, get_misses_{0}, get_requests_{0};   // GET stats
     atomic<long> pop_hits_{0}, pop_misses_{0}, pop_requests_{0};   // POPULAR stats
     atomic<long> total_hits_{0}, total_misses_{0}, total_requests_{0}; // Total across all ops
+    atomic<long> stale_fills_{0};                                  // put_if_newer() calls that were refused
     
     //!!!!!!!!!!!!!!!!!!add here if want another stats , according to access ++,--  and return jason also modify
 };
@@ -185,116 +671,559 @@ private:
 
 
 
+/*=============================================================
+                 cache slices (--shards)
+ ===============================================================
+ The cache is cut into one LRUCache per shard; a key always lives in the
+ slice shard_of(key) picks, and each slice has its own mutex, LRU order
+ and capacity (an equal part of the total). With a single shard this is
+ exactly the old cache. In shard-per-core mode the event loop of shard i
+ is the only loop that looks keys of slice i up, so its mutex is only
+ shared with the workers filling misses of that slice.
+================================================================*/
+class ShardedCache {
+public:
+    ShardedCache(size_t shards, size_t capacity, bool gds, size_t prefetch_capacity) {
+        shards = max<size_t>(1, shards);
+        for (size_t i = 0; i < shards; i++)
+            slices_.emplace_back(new LRUCache((capacity + shards - 1) / shards, gds, (prefetch_capacity + shards - 1) / shards));
+    }
+
+    size_t shards() const { return slices_.size(); }
+    // not the bits LRUCache::stripe() uses, so every slice still spreads its keys over all stripes
+    size_t shard_of(const string &key) const { return hash<string>{}(key) / 4096 % slices_.size(); }
+
+    bool get(const string &key, string &value, bool *prefetched = nullptr, bool count_miss = true) {
+        return of(key).get(key, value, prefetched, count_miss);
+    }
+    bool get_shared(const string &key, shared_ptr<const string> &value, bool *prefetched = nullptr, bool count_miss = true) {
+        return of(key).get_shared(key, value, prefetched, count_miss);
+    }
+    uint64_t fill_ticket(const string &key) const { return of(key).fill_ticket(key); }
+    bool put_if_newer(const string &key, const string &value, uint64_t version, uint64_t ticket, bool is_write = false,
+                      double miss_cost_us = 0) {
+        return of(key).put_if_newer(key, value, version, ticket, is_write, miss_cost_us);
+    }
+    void put_local(const string &key, const string &value) { of(key).put_local(key, value); }
+    bool put_prefetched(const string &key, const string &value, uint64_t version, uint64_t ticket) {
+        return of(key).put_prefetched(key, value, version, ticket);
+    }
+    void apply_remote(const string &key, const string *value, uint64_t version) { of(key).apply_remote(key, value, version); }
+    void erase(const string &key) { of(key).erase(key); }
+    void clear() { for (auto &s : slices_) s->clear(); }
+
+    void count_popular_access() { slices_[0]->count_popular_access(); }
+    // MRU order within each slice, slices interleaved
+    vector<string> keys() const {
+        if (slices_.size() == 1) return slices_[0]->keys();
+        vector<vector<string>> per;
+        size_t total = 0;
+        for (auto &s : slices_) { per.push_back(s->keys()); total += per.back().size(); }
+        vector<string> ks;
+        ks.reserve(total);
+        for (size_t i = 0; ks.size() < total; i++)
+            for (auto &p : per)
+                if (i < p.size()) ks.push_back(std::move(p[i]));
+        return ks;
+    }
+
+    string stats_json() const {
+        LRUCache::Stats st;
+        for (auto &s : slices_) s->add_stats(st);
+        return LRUCache::stats_json(st);
+    }
+
+private:
+    LRUCache &of(const string &key) const { return *slices_[shard_of(key)]; }
+
+    vector<unique_ptr<LRUCache>> slices_;
+};
+
+
+
+
 /*=============================================================
                  main server logic
 ================================================================*/
-int main() {
-    LRUCache cache(CACHE_CAPACITY);//creating instance of LRU cache with specified capacity
-    MYSQL *conn = connect_db(); //establish a connection to the MySQL database using the connect_db()function.
-    if (!conn) { cerr << "DB connection failed\n"; return 1; } 
+int main(int argc, char *argv[]) {
+    ServerConfig cfg;
+    if (!parse_args(argc, argv, cfg)) return 1;
+
+    ShardedCache cache(cfg.shards, CACHE_CAPACITY, cfg.gds_eviction, cfg.prefetch ? cfg.prefetch_capacity : 0);//creating instance of LRU cache with specified capacity
+    string open_error;
+    unique_ptr<KVStore> store = open_store(cfg, open_error); //open the storage tier (MySQL connection or embedded engine)
+    if (!store) { cerr << "Storage open failed: " << open_error << "\n"; return 1; }
+    //answers "definitely absent" for GET misses without touching the store; embedded engines already index keys in memory
+    //(shared: the binlog tailers keep a reference even if loading it fails below)
+    shared_ptr<CountingBloomFilter> key_filter;
+    // headroom over the current row count so new keys do not push the false-positive rate up right away
+    if (cfg.key_filter && cfg.backend == "mysql")
+        key_filter = make_shared<CountingBloomFilter>(max<uint64_t>(cfg.filter_capacity, 2 * store->estimated_keys()));
+
+    // other writers (second server, batch jobs, manual fixes): their row events update or invalidate the cache
+    MySQLStore *following = cfg.binlog ? dynamic_cast<MySQLStore *>(store.get()) : nullptr;
+    if (cfg.binlog && !following) cerr << "--binlog only applies to the mysql backend\n";
+    if (following) {
+        // the binlog is then the filter's only source, own writes included (they come back here as well, until then
+        // the cache or the write-behind queue answers for them): the handlers do not count them a second time.
+        // Deletes up to the end of the key scan are not taken out, the scan may have missed those keys already;
+        // that leaves a few false positives, never a false negative
+        following->follow_binlog(cfg.binlog_server_id,
+            [&cache, filter = key_filter](const string &key, const string *value, uint64_t version, bool inserted,
+                                          bool before_mark) {
+                cache.apply_remote(key, value, version);
+                if (filter && inserted) filter->add(key);
+                if (filter && !value && !before_mark) filter->remove(key);
+            },
+            [&cache] { cache.clear(); }, key_filter != nullptr);
+    }
+    if (key_filter && !load_key_filter(*key_filter, *store, following, cfg)) key_filter.reset();
+    // handler side filter updates, for the writes of this server when no binlog tailer reports them; callers that
+    // cannot tell whether the key is new add it anyway, a key counted twice only costs false positives
+    auto filter_add = [&](const string &key) { if (key_filter && !following) key_filter->add(key); };
+    auto filter_remove = [&](const string &key) { if (key_filter && !following) key_filter->remove(key); };
+
+    unique_ptr<CircuitBreaker> breaker;  //keeps a failing or stalled store out of the request path, cache hits still work
+    if (cfg.breaker) breaker = make_unique<CircuitBreaker>(cfg.breaker_opts, [&store] { return store->ping(); });
+    auto store_allowed = [&] { return !breaker || breaker->allow(); };
+    auto observe = [&](chrono::steady_clock::time_point t0, StoreStatus st) {  //report a finished store call to the breaker
+        if (breaker) breaker->record(st != StoreStatus::ERROR, chrono::steady_clock::now() - t0);
+        return st;
+    };
 
-    mutex db_mutex;  //mutex for accessing database
+    // write-behind queue for X-Durability: async, it flushes through the same breaker as the handlers
+    WriteBehindOptions wb_opts = cfg.write_behind;
+    wb_opts.allow = store_allowed;
+    wb_opts.record = [&](bool ok, chrono::steady_clock::duration d) { if (breaker) breaker->record(ok, d); };
+    wb_opts.erased = filter_remove;
+    WriteBehind writer(*store, wb_opts);
+
+    // read ahead for clients walking numbered keys, results go to the cache's probation list
+    unique_ptr<Prefetcher> prefetcher;
+    if (cfg.prefetch) {
+        PrefetchOptions pf = cfg.prefetch_opts;
+        pf.allow = store_allowed;
+        pf.may_exist = [&](const string &key) { return !key_filter || key_filter->may_contain(key); };
+        pf.ticket = [&](const string &key) { return cache.fill_ticket(key); };
+        pf.pending = [&](const string &key) { string v; return writer.lookup(key, v) != WriteBehind::Pending::NONE; };
+        pf.install = [&](const string &key, const string &value, uint64_t version, uint64_t ticket) {
+            cache.put_prefetched(key, value, version, ticket);
+        };
+        prefetcher = make_unique<Prefetcher>(*store, pf);
+    }
+    array<LatencyHistogram, DURABILITY_LEVELS> write_latency;  //acknowledged PUT/POST/DELETE per durability level
     httplib::Server server;  //instantiate the HTTP server object from the httplib library.
+    WorkerPool pool(cfg.pool);  //serves the accepted connections instead of httplib's fixed size ThreadPool
+    server.new_task_queue = [&] { return pool.task_queue(); };
+
+    // a GET hit answered right on an event loop (shard loops, RESP listener), with the bookkeeping of lookup_value()'s
+    // hit path; a miss is not counted here because the worker that takes the request over looks again
+    auto cache_hit = [&](const string &key, shared_ptr<const string> &val) {
+        bool prefetched = false;
+        if (!cache.get_shared(key, val, &prefetched, false)) return false;
+        if (prefetched && prefetcher) prefetcher->observe(key, true);   //a scan reading its read-ahead, keep ahead of it
+        return true;
+    };
+
+    // --frontend=epoll|uring: the event loops answer the routes below on HTTP_PORT, through the same worker pool
+    unique_ptr<EventServer> events;
+    if (cfg.frontend != "httplib") events = make_unique<EventServer>(pool, cfg.event_loops, cfg.frontend == "uring");
+    if (events && cfg.shards > 1) {
+        // loop i owns cache slice i: GETs of its keys are forwarded to it and a hit is answered on that
+        // core without a worker; misses, writes and the other routes go to the pool as before
+        events->shard(
+            [&cache](const httplib::Request &req) {
+                string key = req.method == "GET" ? kv_key(req) : string();
+                return key.empty() ? -1 : (int)cache.shard_of(key);
+            },
+            [cache_hit](const httplib::Request &req, httplib::Response &res) {
+                string key = req.method == "GET" ? kv_key(req) : string();
+                shared_ptr<const string> val;
+                if (key.empty() || !cache_hit(key, val)) return false;
+                SharedBody::set(res, std::move(val));
+                return true;
+            });
+        events->pin_loops(true);
+    }
+    // httplib still registers every route (its regex matchers), requests without a body are routed by `router`
+    // from the pre-routing hook below before httplib tries a regex; with a body, httplib reads it after that hook
+    Router router;
+    auto route = [&](const string &method, const string &pattern, httplib::Server::Handler handler) {
+        if (events) events->route(method, pattern, handler);
+        router.add(method, pattern, handler);
+        if (method == "GET") server.Get(pattern, handler);
+        else if (method == "PUT") server.Put(pattern, handler);
+        else if (method == "POST") server.Post(pattern, handler);
+        else if (method == "DELETE") server.Delete(pattern, handler);
+    };
 
 
 
 
     // ---------- PUT and POST end points handler ---------- 
-    // This block defines a shared handler that both PUT and POST endpoints will use because they both semantically same.
-    auto handle_put_post = [&](const httplib::Request &request, httplib::Response &response) {
-        string key = request.matches[1]; // Extract the key part from the URL path (captured by the regex `/(.+)`). eg :  PUT /kv/user1 → key = "user1"
-        string val = request.body; // Extract the value from the request body.
-            
-        // writing to DB getting mutex for it
-        lock_guard<mutex> lock(db_mutex); 
-        // Construct an SQL query that inserts or replaces the key-value pair.
-        string q = "REPLACE INTO key_value_table (k,v) VALUES('" + escape_sql(key) + "','" + escape_sql(val) + "')";
-        mysql_query(conn, q.c_str()); // Execute the SQL query on the connected MySQL server.
-    
+    // store_value() is the write path itself, shared by the PUT/POST handler below and the RESP listener's SET
+    auto store_value = [&](const string &key, const string &val, Durability level, httplib::Response &response) {
+        string error;
+        bool created = false;
+        uint64_t version = 0;
+        auto started = chrono::steady_clock::now();
+
+        if (level != DURABILITY_SYNC) {
+            //async: queued for the next batch (kept even while the breaker is open), none: never stored
+            if (level == DURABILITY_ASYNC) {
+                if (!writer.enqueue(key, &val)) { reply_unavailable(response); return; } //queue full, store is not keeping up
+                filter_add(key);
+            }
+            cache.put_local(key, val);
+            write_latency[level].record(chrono::steady_clock::now() - started);
+            response.set_content("OK\n", "text/plain");
+            return;}
+
+        if (!store_allowed()) { reply_unavailable(response); return; } //store is down: refuse instead of queueing up
+        writer.supersede(key); //an older queued async write of the key must not land after this one
+
+        // writing to the store, no lock: the version decides which of two racing cache updates wins
+        uint64_t ticket = cache.fill_ticket(key);
+        auto t0 = chrono::steady_clock::now();
+        if (observe(t0, store->put(key, val, error, key_filter ? &created : nullptr, &version)) == StoreStatus::ERROR) {
+            response.status = 500;
+            response.set_content(error + "\n", "text/plain");
+            return;}
+        if (created) filter_add(key); //count each stored key exactly once so DELETE can take it out again
+
         //after writing to DB update cache ie, write through
-        cache.put(key, val);
+        cache.put_if_newer(key, val, version, ticket, true);
 
+        write_latency[level].record(chrono::steady_clock::now() - started);
         response.set_content("OK\n", "text/plain"); // Respond to client confirming successful write. ie, Send HTTP 200 OK response
     };
+    // This block defines a shared handler that both PUT and POST endpoints will use because they both semantically same.
+    auto handle_put_post = [&](const httplib::Request &request, httplib::Response &response) {
+        Durability level;
+        if (!parse_durability(request, level)) { reply_bad_durability(response); return; }
+        // key = the part of the URL path after the route prefix, eg :  PUT /kv/user1 → key = "user1", value = the body
+        store_value(kv_key(request), request.body, level, response);
+    };
 
     // The PUT endpoint calls handle_put_post() for any path matching /kv/<key>. used to insert or update a key-value pair.
-    server.Put(R"(/table_key_value/(.+))", handle_put_post);
+    route("PUT", R"(/table_key_value/(.+))", handle_put_post);
     // POST behaves identically to PUT here (both perform write-through updates). Some clients may prefer POST for semantic reasons (e.g., creating new data).
-    server.Post(R"(/table_key_value/(.+))", handle_put_post);
+    route("POST", R"(/table_key_value/(.+))", handle_put_post);
 
 
 
 
    // ---------- GET endpoint handles HTTP GET requests for key lookups----------
-   // it first checks the cache; if not found, it queries the MySQL database and updates the cache before returning the result.
-   server.Get(R"(/table_key_value/(.+))", [&](const httplib::Request &request, httplib::Response &response) {
-    string key = request.matches[1], val; // extract the key , val from url request
+   // it first checks the cache; if not found, it queries the store and updates the cache before returning the result.
+   // (lookup_value() also serves the RESP listener's GET and MGET)
+   auto lookup_value = [&](const string &key, httplib::Response &response) {
+    string val, error;
     
-    if (cache.get(key, val)) { //check cache first
-        response.set_content(val, "text/plain");
+    bool prefetched = false;
+    shared_ptr<const string> cached;
+    if (cache.get_shared(key, cached, &prefetched)) { //check cache first
+        if (prefetched && prefetcher) prefetcher->observe(key, true); //a scan reading its read-ahead, keep ahead of it
+        SharedBody::set(response, std::move(cached)); //the cached buffer itself is the body, sent without a copy
         return;}// if found no need to go to DB just repond
+        if (prefetcher) prefetcher->observe(key, false); //feeds scan detection
+
+        //cache miss: an async write that is still queued is the newest value (ticket first, see LRUCache)
+        uint64_t ticket = cache.fill_ticket(key), version = 0;
+        WriteBehind::Pending queued = writer.lookup(key, val);
+        if (queued == WriteBehind::Pending::PUT) {
+            response.set_content(val, "text/plain");
+            return;}
+        if (queued == WriteBehind::Pending::DELETE) {
+            response.status = 404;
+            response.set_content("Key not found\n", "text/plain");
+            return;}
 
-        //cache miss so then aquire DB mutex
-        lock_guard<mutex> lock(db_mutex);
-        string q = "SELECT v FROM key_value_table WHERE k='" + escape_sql(key) + "' LIMIT 1"; //sql query prepare
-        mysql_query(conn, q.c_str()); //execute sql query
-        MYSQL_RES *r = mysql_store_result(conn); // Retrieve the query result from MySQL.
-        
-        if (r) { // Check if any row was returned.
-            MYSQL_ROW row = mysql_fetch_row(r);  // Fetch the first row.           
-            if (row && row[0]) {           // If the row exists and contains a value:
-                val = row[0];              // Extract value from the result.
-                cache.put(key, val);       // Store it in cache for future GETs.
-                response.set_content(val, "text/plain");  // Send to client.
-                mysql_free_result(r);      // Free MySQL result memory.
-                return;                    // Exit after responding successfully.
-            }
-        mysql_free_result(r);} // If no matching key was found in DB, free result memory anyway.
+        //a key the filter has never seen cannot be in the store either
+        if (key_filter && !key_filter->may_contain(key)) {
+            response.status = 404;
+            response.set_content("Key not found\n", "text/plain");
+            return;}
+
+        if (!store_allowed()) { reply_unavailable(response); return; } //degraded mode: only cache hits are served
+
+        //read the store, the fill is refused if a newer write or a delete got to the cache first
+        auto t0 = chrono::steady_clock::now();
+        StoreStatus st = observe(t0, store->get(key, val, error, &version));
+        if (st == StoreStatus::OK) {
+            double cost_us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+            cache.put_if_newer(key, val, version, ticket, false, cost_us);       // Store it in cache for future GETs.
+            response.set_content(val, "text/plain");  // Send to client.
+            return;}
+        if (st == StoreStatus::ERROR) {
+            response.status = 500;
+            response.set_content(error + "\n", "text/plain");
+            return;}
+        if (key_filter) key_filter->record_false_positive();
     
         //if bothe cache and DB miss
     response.status = 404;
     response.set_content("Key not found\n", "text/plain");
+    };
+   route("GET", R"(/table_key_value/(.+))", [&](const httplib::Request &request, httplib::Response &response) {
+    lookup_value(kv_key(request), response); // extract the key from url request
     });
 
 
 
 
    //------------DELETE endpoint handles HTTP DELETE requests----------
-   server.Delete(R"(/table_key_value/(.+))", [&](const httplib::Request &request, httplib::Response &response) {
-        string key = request.matches[1];
-        bool found = false;
-
-        // first trying to delete from DB
-        {   lock_guard<mutex> lock(db_mutex);
-            string q = "DELETE FROM key_value_table WHERE k='" + escape_sql(key) + "'";
-            if (mysql_query(conn, q.c_str())) {
-                response.status = 500;
-                response.set_content(string("DB error: ") + mysql_error(conn), "text/plain");
-                return;}
-            
-                // Check if a row was actually deleted
-            if (mysql_affected_rows(conn) > 0)
-                found = true;}
+   // (erase_value() also serves the RESP listener's DEL)
+   auto erase_value = [&](const string &key, Durability level, httplib::Response &response) {
+        string error;
+        auto started = chrono::steady_clock::now();
+
+        if (level != DURABILITY_SYNC) {
+            //async: the row goes with the next batch, none: only the cached copy is dropped
+            if (level == DURABILITY_ASYNC && !writer.enqueue(key, nullptr)) { reply_unavailable(response); return; }
+            cache.erase(key);
+            write_latency[level].record(chrono::steady_clock::now() - started);
+            response.set_content("Deleted\n", "text/plain");
+            return;}
+
+        if (!store_allowed()) { reply_unavailable(response); return; }
+        writer.supersede(key);
+
+        // first trying to delete from the store
+        auto t0 = chrono::steady_clock::now();
+        StoreStatus st = observe(t0, store->erase(key, error));
+        if (st == StoreStatus::ERROR) {
+            response.status = 500;
+            response.set_content(error, "text/plain");
+            return;}
 
         // delete from cache (if it exists)
         cache.erase(key);
+        if (st == StoreStatus::OK) filter_remove(key);
 
-        if (found) {
+        if (st == StoreStatus::OK) {
+            write_latency[level].record(chrono::steady_clock::now() - started);
             response.set_content("Deleted\n", "text/plain");
         } else {
             response.status = 404;
             response.set_content("Key not found — cannot delete\n", "text/plain");
         }
+    };
+   route("DELETE", R"(/table_key_value/(.+))", [&](const httplib::Request &request, httplib::Response &response) {
+        Durability level;
+        if (!parse_durability(request, level)) { reply_bad_durability(response); return; }
+        erase_value(kv_key(request), level, response);
     });
 
+   //------------batch endpoints: POST /mget, /mput, /mdelete (see frame_batch() for the response)----------
+   // one pass over the cache, then one multi-key store call (get_many / put_many / erase_many) for the rest;
+   // the status per key is the one the single-key route would answer
+   auto status_of = [](const httplib::Response &r) { return r.status == -1 ? 200 : r.status; };
+   auto lookup_values = [&](const vector<string> &keys, BatchReplies &out) {
+        out.assign(keys.size(), {404, ""});
+        vector<size_t> misses;
+        vector<string> miss_keys;
+        vector<uint64_t> tickets;
+        for (size_t i = 0; i < keys.size(); i++) {
+            string &val = out[i].second;
+            if (cache.get(keys[i], val)) { out[i].first = 200; continue; }
+            uint64_t ticket = cache.fill_ticket(keys[i]);      //same order as lookup_value(): ticket, queued writes, filter
+            WriteBehind::Pending queued = writer.lookup(keys[i], val);
+            if (queued == WriteBehind::Pending::PUT) { out[i].first = 200; continue; }
+            if (queued == WriteBehind::Pending::DELETE) continue;
+            if (key_filter && !key_filter->may_contain(keys[i])) continue;
+            misses.push_back(i);
+            miss_keys.push_back(keys[i]);
+            tickets.push_back(ticket);
+        }
+        if (misses.empty()) return;
+        if (!store_allowed()) { for (size_t i : misses) out[i] = {503, ""}; return; }
+        vector<KVRead> reads;
+        string error;
+        auto t0 = chrono::steady_clock::now();
+        if (observe(t0, store->get_many(miss_keys, reads, error)) == StoreStatus::ERROR) {
+            for (size_t i : misses) out[i] = {500, error};
+            return;}
+        double cost_us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count() / misses.size();
+        for (size_t j = 0; j < misses.size(); j++) {
+            if (!reads[j].found) { if (key_filter) key_filter->record_false_positive(); continue; }
+            cache.put_if_newer(miss_keys[j], reads[j].value, reads[j].version, tickets[j], false, cost_us);
+            out[misses[j]] = {200, std::move(reads[j].value)};
+        }
+   };
+   auto store_values = [&](const vector<pair<string, string>> &kvs, Durability level, BatchReplies &out) {
+        out.assign(kvs.size(), {200, ""});
+        if (level != DURABILITY_SYNC) {    //no store statement involved, the single-key path per pair
+            for (size_t i = 0; i < kvs.size(); i++) {
+                httplib::Response r;
+                store_value(kvs[i].first, kvs[i].second, level, r);
+                if (status_of(r) != 200) out[i] = {status_of(r), r.body};
+            }
+            return;}
+        if (!store_allowed()) { for (auto &o : out) o.first = 503; return; }
+        auto started = chrono::steady_clock::now();
+        for (const auto &kv : kvs) writer.supersede(kv.first);
+        string error;
+        if (observe(started, store->put_many(kvs, error)) == StoreStatus::ERROR) {
+            for (auto &o : out) o = {500, error};
+            return;}
+        //put_many() reports no versions: drop the cached copies like /bulk_ingest, the next GET reads the new value
+        for (const auto &kv : kvs) {
+            cache.erase(kv.first);
+            filter_add(kv.first);
+        }
+        write_latency[level].record(chrono::steady_clock::now() - started);
+   };
+   auto erase_values = [&](const vector<string> &keys, Durability level, BatchReplies &out) {
+        out.assign(keys.size(), {200, ""});
+        if (level != DURABILITY_SYNC) {
+            for (size_t i = 0; i < keys.size(); i++) {
+                httplib::Response r;
+                erase_value(keys[i], level, r);
+                if (status_of(r) != 200) out[i] = {status_of(r), r.body};
+            }
+            return;}
+        if (!store_allowed()) { for (auto &o : out) o.first = 503; return; }
+        auto started = chrono::steady_clock::now();
+        for (const string &key : keys) writer.supersede(key);
+        vector<EraseResult> erased;
+        string error;
+        if (observe(started, store->erase_many(keys, erased, error)) == StoreStatus::ERROR) {
+            for (auto &o : out) o = {500, error};
+            return;}
+        for (size_t i = 0; i < keys.size(); i++) {
+            cache.erase(keys[i]);
+            if (erased[i] == EraseResult::DELETED) filter_remove(keys[i]);
+            else out[i].first = 404;
+        }
+        write_latency[level].record(chrono::steady_clock::now() - started);
+   };
+   route("POST", "/mget", [&](const httplib::Request &request, httplib::Response &response) {
+        vector<string> keys;
+        if (!parse_batch_keys(request.body, keys)) { reply_bad_batch(response); return; }
+        BatchReplies replies;
+        lookup_values(keys, replies);
+        response.set_content(frame_batch(keys, replies), "text/plain");
+   });
+   route("POST", "/mput", [&](const httplib::Request &request, httplib::Response &response) {
+        Durability level;
+        if (!parse_durability(request, level)) { reply_bad_durability(response); return; }
+        vector<pair<string, string>> kvs;
+        if (!parse_batch_pairs(request.body, kvs)) { reply_bad_batch(response); return; }
+        BatchReplies replies;
+        store_values(kvs, level, replies);
+        vector<string> keys;
+        for (auto &kv : kvs) keys.push_back(std::move(kv.first));
+        response.set_content(frame_batch(keys, replies), "text/plain");
+   });
+   route("POST", "/mdelete", [&](const httplib::Request &request, httplib::Response &response) {
+        Durability level;
+        if (!parse_durability(request, level)) { reply_bad_durability(response); return; }
+        vector<string> keys;
+        if (!parse_batch_keys(request.body, keys)) { reply_bad_batch(response); return; }
+        BatchReplies replies;
+        erase_values(keys, level, replies);
+        response.set_content(frame_batch(keys, replies), "text/plain");
+   });
+
+   //------------Redis protocol listener (--resp-port): same read / write / delete paths, sync durability----------
+   unique_ptr<RespServer> resp;
+   if (cfg.resp_port) {
+        RespCommands cmds;
+        cmds.get = lookup_value;
+        cmds.set = [&](const string &key, const string &value, httplib::Response &response) {
+            store_value(key, value, DURABILITY_SYNC, response);
+        };
+        cmds.del = [&](const string &key, httplib::Response &response) { erase_value(key, DURABILITY_SYNC, response); };
+        cmds.get_many = lookup_values;
+        cmds.del_many = [&](const vector<string> &keys, BatchReplies &out) { erase_values(keys, DURABILITY_SYNC, out); };
+        cmds.hit = cache_hit;
+        resp = make_unique<RespServer>(pool, cmds, cfg.event_loops);
+   }
+
     
 
 
 
 
 
+//---------------bulk ingest. POST /bulk_ingest streams "key<TAB>value\n" records into the store----------------
+// the body is parsed while it arrives, every BULK_BATCH_BYTES are written with store->put_many() in the
+// background while the next batch is read, e.g. curl -X POST --data-binary @data.tsv localhost:8080/bulk_ingest
+server.Post("/bulk_ingest", [&](const httplib::Request &, httplib::Response &response, const httplib::ContentReader &content_reader) {
+    if (!store_allowed()) { reply_unavailable(response); return; }
+    auto t0 = chrono::steady_clock::now();
+    vector<pair<string, string>> batch;
+    size_t batch_bytes = 0;
+    future<string> writing;              // previous batch, "" when it was written fine
+    string pending, error;               // pending = partial line carried over to the next chunk
+    long rows = 0, skipped = 0;
+
+    // write one batch, then drop stale cached copies so the next GET reads the loaded value
+    auto write_batch = [&](vector<pair<string, string>> kvs) -> string {
+        string err;
+        if (store->put_many(kvs, err) == StoreStatus::ERROR) return err;
+        for (const auto &kv : kvs) {
+            cache.erase(kv.first);
+            filter_add(kv.first);
+        }
+        return "";
+    };
+    auto wait_writing = [&] {
+        if (!writing.valid()) return;
+        string e = writing.get();
+        if (!e.empty() && error.empty()) error = e;
+    };
+    auto submit = [&] {
+        wait_writing();                  // at most one batch in flight besides the one being parsed
+        if (!error.empty() || batch.empty()) return;
+        writing = async(launch::async, write_batch, std::move(batch));
+        batch = {};
+        batch_bytes = 0;
+    };
+    auto parse_line = [&](const char *p, size_t n) {
+        if (n > 0 && p[n - 1] == '\r') n--;
+        const char *tab = static_cast<const char *>(memchr(p, '\t', n));
+        if (!tab || tab == p) { if (n > 0) skipped++; return; }   // no key: malformed record
+        batch.emplace_back(string(p, tab - p), string(tab + 1, p + n - tab - 1));
+        batch_bytes += n;
+        rows++;
+    };
+
+    content_reader([&](const char *data, size_t len) {
+        pending.append(data, len);
+        size_t start = 0, nl;
+        while ((nl = pending.find('\n', start)) != string::npos) {
+            parse_line(pending.data() + start, nl - start);
+            start = nl + 1;
+        }
+        pending.erase(0, start);
+        if (batch_bytes >= BULK_BATCH_BYTES) submit();
+        return error.empty();            // stop reading after a failed batch
+    });
+    if (!pending.empty()) parse_line(pending.data(), pending.size());   // last record without a newline
+    submit();
+    wait_writing();
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    stringstream ss;
+    ss << fixed << setprecision(1);
+    ss << "{\"rows\": " << rows << ", \"skipped\": " << skipped << ", \"seconds\": " << secs
+       << ", \"rows_per_sec\": " << (secs > 0 ? rows / secs : 0.0);
+    if (!error.empty()) {
+        response.status = 500;
+        for (char &c : error) if (c == '"' || c == '\\') c = '\'';   //keep the JSON string valid
+        ss << ", \"error\": \"" << error << "\"";   // rows counts parsed records, not all of them reached the store
+    }
+    ss << "}\n";
+    cout << "Bulk ingest: " << ss.str();
+    response.set_content(ss.str(), "application/json");
+});
+
+
+
+
 //---------------popular. Handles GET /popular MRU keys in cache----------------
-server.Get("/popular", [&](const httplib::Request &, httplib::Response &response) {
+route("GET", "/popular", [&](const httplib::Request &, httplib::Response &response) {
     cache.count_popular_access(); // Increments total/popular request counters, and counts hit/miss
     auto keys = cache.keys(); // Retrieve the current cache keys in Most-Recently-Used (MRU) order.
     size_t n = min<size_t>(10, keys.size()); // Limit the output to at most 10 keys even if cache has more if i put any number instead of 10 then can get upto that
@@ -315,8 +1244,19 @@ server.Get("/popular", [&](const httplib::Request &, httplib::Response &response
 
 
 //---------------stats. Handles GET /stats — returns the current cache performance statistics---------------
-server.Get("/stats", [&](const httplib::Request &, httplib::Response &response) {
+route("GET", "/stats", [&](const httplib::Request &, httplib::Response &response) {
     string stats_json = cache.stats_json(); // The function `cache.stats_json()` builds this JSON report, its inside the cache.
+    if (key_filter) append_stats_section(stats_json, "key_filter", key_filter->stats_json());
+    if (breaker) append_stats_section(stats_json, "circuit_breaker", breaker->stats_json());
+    if (prefetcher) append_stats_section(stats_json, "prefetcher", prefetcher->stats_json());
+    append_stats_section(stats_json, "workers", pool.stats_json());
+    if (events) append_stats_section(stats_json, "event_loops", events->stats_json());
+    if (resp) append_stats_section(stats_json, "resp", resp->stats_json());
+    string durability = "{";
+    for (int i = 0; i < DURABILITY_LEVELS; i++)
+        durability += string(i ? ", " : "") + "\"" + DURABILITY_NAMES[i] + "\": " + write_latency[i].stats_json();
+    append_stats_section(stats_json, "durability", durability + ", \"write_behind\": " + writer.stats_json() + "}");
+    append_stats_section(stats_json, "storage", "{\"backend\": \"" + string(store->name()) + "\", \"engine\": " + store->stats_json() + "}");
     response.set_content(stats_json, "application/json"); // Send the JSON statistics as the HTTP response body.content type is set to "application/json" so clients know it's structured data
 });
 
@@ -324,7 +1264,7 @@ server.Get("/stats", [&](const httplib::Request &, httplib::Response &response)
 
 
 // ---------- health, HTTP GET endpoint at path "/health"  to verify if the server is running and responsive. ----------
-server.Get("/health", [&](const httplib::Request &, httplib::Response &response) {
+route("GET", "/health", [&](const httplib::Request &, httplib::Response &response) {
     // Set the HTTP response body content to a simple text message "OK\n".
     response.set_content("OK\n", "text/plain");
 });
@@ -333,7 +1273,7 @@ server.Get("/health", [&](const httplib::Request &, httplib::Response &response)
 
 
  // ---------- DEFAULT 404 HANDLER. ie, It will be called automatically whenever any request fails----------
-server.set_error_handler([](const httplib::Request &request, httplib::Response &response) {
+auto error_handler = [](const httplib::Request &request, httplib::Response &response) {
     if (response.status == 404) { // Check if the error status is 404 → resource not found
         stringstream ss;  // Create a stringstream to build the response text dynamically        
         ss << "404 Not Found\n" // Construct a descriptive error message including the HTTP method and path
@@ -343,18 +1283,40 @@ server.set_error_handler([](const httplib::Request &request, httplib::Response &
     else if (response.status == 405) { // If the status is 405 → method not allowed (e.g., POST to a GET-only endpoint)
         response.set_content("405 Method Not Allowed\n", "text/plain");  // Respond with a plain-text message for clarity
     }    
+    else if (response.status == 503) { // circuit breaker open → the store is skipped until a probe succeeds
+        response.set_content("503 Service Unavailable — storage is down, only cached keys are served\n", "text/plain");
+    }
     else if (response.status >= 500) { // If the status is 500 or higher → internal server error (unexpected failures)
         response.set_content("500 Internal Server Error\n", "text/plain"); // Respond with a simple internal server error message
     }
+};
+server.set_error_handler(error_handler);
+server.set_pre_routing_handler([&](const httplib::Request &request, httplib::Response &response) {
+    if (request.has_header("Content-Length") || request.has_header("Transfer-Encoding"))
+        return httplib::Server::HandlerResponse::Unhandled;   //the body is read later, by httplib's own routing
+    const Router::Handler *handler = router.find(request.method, request.path);
+    if (!handler) return httplib::Server::HandlerResponse::Unhandled;
+    (*handler)(request, response);
+    return httplib::Server::HandlerResponse::Handled;
 });
+if (events) events->set_error_handler(error_handler);
 
 
 
 
-    cout << "Server running at http://127.0.0.1:8080\n";
-    server.listen("0.0.0.0", 8080);                        //is the one that starts an infinite event loop inside the httplib library. like while(1) so it in kind of blockin state
+    if (events) {
+        if (!events->start("0.0.0.0", HTTP_PORT)) return 1;
+        cout << cfg.frontend << " front end: " << cfg.event_loops << (cfg.shards > 1 ? " pinned shard" : "")
+             << " event loops on port " << HTTP_PORT
+             << ", /bulk_ingest on port " << HTTPLIB_SIDE_PORT << "\n";
+    }
+    if (resp) {
+        if (!resp->start("0.0.0.0", cfg.resp_port)) return 1;
+        cout << "Redis protocol (GET/SET/DEL/MGET) on port " << cfg.resp_port << "\n";
+    }
+    cout << "Server running at http://127.0.0.1:" << HTTP_PORT << " (backend: " << store->name() << ")\n";
+    server.listen("0.0.0.0", events ? HTTPLIB_SIDE_PORT : HTTP_PORT);                        //is the one that starts an infinite event loop inside the httplib library. like while(1) so it in kind of blockin state
 
     //for debugging this not reached cause always listening its kinda blocked 
-    mysql_close(conn);
     return 0;
 }
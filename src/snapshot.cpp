@@ -0,0 +1,540 @@
+/*=============================================================
+        snapshot — parallel export / import of the key-value data
+ ===============================================================
+ ./bin/snapshot export <file> [--threads=8] [--chunks=<ranges per table>]
+                              [--partitions=<n>] [--db-hosts=<host:port,...>]
+ ./bin/snapshot import <file> [--threads=4] [--backend=mysql|bitcask|lsm] [--data-dir=<path>]
+                              [--partitions=<n>] [--db-hosts=<host:port,...>]
+ ./bin/snapshot verify <file>
+
+ export: every key_value_table[_<p>] is cut into key ranges (boundaries are
+ existing keys found with a few index lookups), and --threads connections
+ stream the ranges with mysql_use_result, so rows are never buffered whole.
+ import: one thread reads the file in large sequential reads and splits it
+ into blocks, --threads writers check and decode the blocks and hand them
+ to the store's put_many() (any backend, keys are re-partitioned for the
+ target's --partitions).
+
+ File format (host byte order, little endian on x86):
+   header  "KVSNAP1\n" | u64 created (unix microseconds)
+   block   u32 payload bytes | u32 records | u32 crc32(payload) | payload
+           payload = records of: varint key bytes, varint value bytes, key, value
+   end     u32 0 | u32 0 | u32 crc32(total) | u64 total records
+ Blocks (~1MB) are independent and appended in whatever order the export
+ threads finish them; the end block tells a complete file from a cut one.
+================================================================*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include "kv_store.h"
+#include "mysql_store.h"
+#include "bitcask.h"
+#include "lsm.h"
+
+using namespace std;
+
+constexpr char SNAP_MAGIC[8] = {'K', 'V', 'S', 'N', 'A', 'P', '1', '\n'};
+constexpr size_t SNAP_HEADER_BYTES = 16;
+constexpr size_t BLOCK_HEADER_BYTES = 12;
+constexpr size_t BLOCK_BYTES = 1 << 20;      // a block is closed once its payload passes this
+constexpr size_t READ_BYTES = 8 << 20;       // import / verify read the file in chunks this large
+constexpr unsigned int EXPORT_TIMEOUT_S = 60;// connect / read timeout of the export connections
+
+
+
+
+/*=============================================================
+                 command line configuration
+================================================================*/
+struct SnapshotConfig {
+    string mode, file;
+    int threads = 0;                   // 0 → 8 for export, 4 for import
+    int chunks = 0;                    // export: ranges per table, 0 → 4 per thread
+    int partitions = 1;                // key_value_table_<p> tables (source for export, target for import)
+    vector<DBEndpoint> db_hosts;
+    string backend = "mysql";          // import target
+    string data_dir = "data";
+};
+
+void usage() {
+    cerr << "Usage: ./snapshot export <file> [--threads=<n>] [--chunks=<per table>] [--partitions=<n>] [--db-hosts=<host:port,...>]\n"
+         << "       ./snapshot import <file> [--threads=<n>] [--backend=mysql|bitcask|lsm] [--data-dir=<path>]\n"
+         << "                                [--partitions=<n>] [--db-hosts=<host:port,...>]\n"
+         << "       ./snapshot verify <file>\n";
+}
+
+bool parse_args(int argc, char *argv[], SnapshotConfig &cfg) {
+    if (argc < 3) { usage(); return false; }
+    cfg.mode = argv[1];
+    cfg.file = argv[2];
+    if (cfg.mode != "export" && cfg.mode != "import" && cfg.mode != "verify") { usage(); return false; }
+    for (int i = 3; i < argc; i++) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) != 0 || eq == string::npos) { usage(); return false; }
+        string name = arg.substr(2, eq - 2), value = arg.substr(eq + 1);
+        if (name == "threads") cfg.threads = stoi(value);
+        else if (name == "chunks") cfg.chunks = stoi(value);
+        else if (name == "partitions") cfg.partitions = max(1, stoi(value));
+        else if (name == "backend") cfg.backend = value;
+        else if (name == "data-dir") cfg.data_dir = value;
+        else if (name == "db-hosts") {
+            stringstream list(value);
+            for (string item; getline(list, item, ',');) {
+                DBEndpoint ep;
+                size_t colon = item.rfind(':');
+                ep.host = item.substr(0, colon);
+                if (colon != string::npos) ep.port = stoul(item.substr(colon + 1));
+                cfg.db_hosts.push_back(ep);
+            }
+        }
+        else { cerr << "Unknown option: " << arg << "\n"; usage(); return false; }
+    }
+    if (cfg.db_hosts.empty()) cfg.db_hosts.push_back(DBEndpoint());
+    if (cfg.threads <= 0) cfg.threads = (cfg.mode == "export" ? 8 : 4);
+    if (cfg.chunks <= 0) cfg.chunks = 4 * cfg.threads;
+    return true;
+}
+
+double seconds_since(chrono::steady_clock::time_point t0) {
+    return chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+
+
+
+/*=============================================================
+                     snapshot file format
+================================================================*/
+inline void put_varint(string &out, uint64_t v) {
+    while (v >= 0x80) { out += (char)(v | 0x80); v >>= 7; }
+    out += (char)v;
+}
+
+inline bool get_varint(const char *&p, const char *end, uint64_t &v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char c = *p++;
+        v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return true;
+    }
+    return false;
+}
+
+inline void put_record(string &payload, const char *k, size_t klen, const char *v, size_t vlen) {
+    put_varint(payload, klen);
+    put_varint(payload, vlen);
+    payload.append(k, klen);
+    payload.append(v, vlen);
+}
+
+// every record of one block payload, false if it does not parse
+bool decode_block(const string &payload, uint32_t records, vector<pair<string, string>> &out) {
+    const char *p = payload.data(), *end = p + payload.size();
+    out.reserve(out.size() + records);
+    for (uint32_t i = 0; i < records; i++) {
+        uint64_t klen, vlen;
+        if (!get_varint(p, end, klen) || !get_varint(p, end, vlen) || (uint64_t)(end - p) < klen + vlen) return false;
+        out.emplace_back(string(p, klen), string(p + klen, vlen));
+        p += klen + vlen;
+    }
+    return p == end;
+}
+
+
+// export side: blocks from any thread are appended at the next free offset
+class SnapshotWriter {
+public:
+    bool open(const string &path, string &error) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd_ < 0) { error = "cannot create " + path + ": " + strerror(errno); return false; }
+        char hdr[SNAP_HEADER_BYTES];
+        uint64_t now = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+        memcpy(hdr, SNAP_MAGIC, 8);
+        memcpy(hdr + 8, &now, 8);
+        if (!pwrite_all(fd_, hdr, sizeof(hdr), 0)) { error = string("write failed: ") + strerror(errno); return false; }
+        off_ = SNAP_HEADER_BYTES;
+        return true;
+    }
+
+    bool append(const string &payload, uint32_t records) {
+        char hdr[BLOCK_HEADER_BYTES];
+        uint32_t len = payload.size(), crc = crc32(payload.data(), payload.size());
+        memcpy(hdr, &len, 4);
+        memcpy(hdr + 4, &records, 4);
+        memcpy(hdr + 8, &crc, 4);
+        uint64_t off;
+        {   lock_guard<mutex> lk(mu_);
+            off = off_;
+            off_ += BLOCK_HEADER_BYTES + len;
+            total_ += records;
+        }
+        return pwrite_all(fd_, hdr, sizeof(hdr), off) && pwrite_all(fd_, payload.data(), len, off + BLOCK_HEADER_BYTES);
+    }
+
+    // end block, then make the file durable
+    bool finish(string &error) {
+        char end[BLOCK_HEADER_BYTES + 8] = {};
+        uint32_t crc = crc32(&total_, 8);
+        memcpy(end + 8, &crc, 4);
+        memcpy(end + 12, &total_, 8);
+        bool ok = pwrite_all(fd_, end, sizeof(end), off_) && ::fdatasync(fd_) == 0;
+        if (!ok) error = string("write failed: ") + strerror(errno);
+        ::close(fd_);
+        return ok;
+    }
+
+    uint64_t bytes() const { return off_ + BLOCK_HEADER_BYTES + 8; }
+    uint64_t records() const { return total_; }
+
+private:
+    int fd_ = -1;
+    mutex mu_;
+    uint64_t off_ = 0, total_ = 0;
+};
+
+
+// import / verify side: sequential large reads, `on_block` gets every block in file order
+bool read_snapshot(const string &path, const function<bool(string &&payload, uint32_t records, uint32_t crc)> &on_block,
+                   uint64_t &records, uint64_t &bytes, string &error) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { error = "cannot open " + path + ": " + strerror(errno); return false; }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    string buf;
+    size_t pos = 0;
+    bool eof = false;
+    bytes = 0;
+    // make at least `n` unread bytes available in buf[pos..], false at end of file
+    auto fill = [&](size_t n) {
+        while (buf.size() - pos < n && !eof) {
+            buf.erase(0, pos);
+            pos = 0;
+            size_t have = buf.size();
+            buf.resize(have + max(READ_BYTES, n));
+            ssize_t got = ::read(fd, &buf[have], buf.size() - have);
+            if (got < 0 && errno == EINTR) { buf.resize(have); continue; }
+            if (got <= 0) { eof = true; got = 0; }
+            buf.resize(have + got);
+            bytes += got;
+        }
+        return buf.size() - pos >= n;
+    };
+
+    bool ok = false;
+    uint64_t counted = 0;
+    if (!fill(SNAP_HEADER_BYTES) || memcmp(buf.data(), SNAP_MAGIC, 8) != 0) {
+        error = path + " is not a snapshot file";
+    } else {
+        pos = SNAP_HEADER_BYTES;
+        while (true) {
+            if (!fill(BLOCK_HEADER_BYTES)) { error = "file is truncated (no end block)"; break; }
+            uint32_t len, n, crc;
+            memcpy(&len, buf.data() + pos, 4);
+            memcpy(&n, buf.data() + pos + 4, 4);
+            memcpy(&crc, buf.data() + pos + 8, 4);
+            pos += BLOCK_HEADER_BYTES;
+            if (len == 0 && n == 0) {       // end block
+                uint64_t total;
+                if (!fill(8)) { error = "file is truncated (end block)"; break; }
+                memcpy(&total, buf.data() + pos, 8);
+                if (crc32(&total, 8) != crc || total != counted) {
+                    error = "end block says " + to_string(total) + " records, blocks hold " + to_string(counted);
+                    break;
+                }
+                ok = true;
+                break;
+            }
+            if (!fill(len)) { error = "file is truncated inside a block"; break; }
+            string payload(buf.data() + pos, len);
+            pos += len;
+            counted += n;
+            if (!on_block(std::move(payload), n, crc)) { error = "stopped"; break; }
+        }
+    }
+    ::close(fd);
+    records = counted;
+    return ok;
+}
+
+
+
+
+/*=============================================================
+                 export: ranges over the tables
+================================================================*/
+struct Range {
+    int partition;
+    string lo, hi;      // lo <= k < hi, empty = unbounded
+};
+
+// run a statement with a small stored result
+bool query_rows(MYSQL *conn, const string &sql, vector<vector<string>> &rows, string &error) {
+    rows.clear();
+    if (mysql_real_query(conn, sql.data(), sql.size()) != 0) { error = string("DB error: ") + mysql_error(conn); return false; }
+    MYSQL_RES *res = mysql_store_result(conn);
+    if (!res) { error = string("DB error: ") + mysql_error(conn); return false; }
+    unsigned int cols = mysql_num_fields(res);
+    while (MYSQL_ROW row = mysql_fetch_row(res)) {
+        unsigned long *len = mysql_fetch_lengths(res);
+        vector<string> out(cols);
+        for (unsigned int i = 0; i < cols; i++) if (row[i]) out[i].assign(row[i], len[i]);
+        rows.push_back(std::move(out));
+    }
+    mysql_free_result(res);
+    return true;
+}
+
+// n-1 strings evenly spaced between lo and hi, interpolating the 8 bytes after their common prefix
+vector<string> split_points(const string &lo, const string &hi, int n) {
+    size_t pre = 0;
+    while (pre < lo.size() && pre < hi.size() && lo[pre] == hi[pre]) pre++;
+    auto num = [&](const string &s) {
+        uint64_t v = 0;
+        for (size_t i = 0; i < 8; i++) v = (v << 8) | (pre + i < s.size() ? (unsigned char)s[pre + i] : 0);
+        return v;
+    };
+    uint64_t a = num(lo), b = num(hi);
+    vector<string> out;
+    for (int i = 1; i < n && b > a; i++) {
+        uint64_t v = a + (uint64_t)((long double)(b - a) * i / n);
+        string s = lo.substr(0, pre);
+        for (int j = 7; j >= 0; j--) s += (char)(v >> (8 * j));
+        while (s.size() > pre && s.back() == '\0') s.pop_back();
+        out.push_back(s);
+    }
+    return out;
+}
+
+// cut one table into about `chunks` ranges. Interpolated points are snapped to the next existing key and
+// then ordered by MySQL itself, so the ranges follow the column's collation order and never overlap.
+bool plan_ranges(MYSQL *conn, int p, int partitions, int chunks, vector<Range> &ranges, string &error) {
+    string table = partition_table(p, partitions);
+    vector<vector<string>> rows;
+    if (!query_rows(conn, "SELECT MIN(k), MAX(k), MIN(k) IS NULL FROM " + table, rows, error)) return false;
+    if (rows.empty() || rows[0][2] == "1") return true;                      // empty table
+    vector<string> bounds;
+    for (const string &point : split_points(rows[0][0], rows[0][1], chunks)) {
+        vector<vector<string>> next;
+        if (!query_rows(conn, "SELECT k FROM " + table + " WHERE k >= '" + escape_sql(point) + "' ORDER BY k LIMIT 1", next, error))
+            return false;
+        if (!next.empty()) bounds.push_back(next[0][0]);
+    }
+    if (!bounds.empty()) {
+        string in;
+        for (const string &b : bounds) in += (in.empty() ? "'" : ",'") + escape_sql(b) + "'";
+        if (!query_rows(conn, "SELECT k FROM " + table + " WHERE k IN (" + in + ") ORDER BY k", rows, error)) return false;
+        bounds.clear();
+        for (auto &r : rows) bounds.push_back(r[0]);
+    }
+    string lo;
+    for (const string &b : bounds) {
+        ranges.push_back(Range{p, lo, b});
+        lo = b;
+    }
+    ranges.push_back(Range{p, lo, ""});
+    return true;
+}
+
+// stream one range into blocks
+bool export_range(MYSQL *conn, const Range &r, int partitions, SnapshotWriter &out, atomic<uint64_t> &rows, string &error) {
+    string sql = "SELECT k, v FROM " + partition_table(r.partition, partitions);
+    if (!r.lo.empty()) sql += " WHERE k >= '" + escape_sql(r.lo) + "'";
+    if (!r.hi.empty()) sql += (r.lo.empty() ? " WHERE" : " AND") + string(" k < '") + escape_sql(r.hi) + "'";
+    if (mysql_real_query(conn, sql.data(), sql.size()) != 0) { error = string("DB error: ") + mysql_error(conn); return false; }
+    MYSQL_RES *res = mysql_use_result(conn);
+    if (!res) { error = string("DB error: ") + mysql_error(conn); return false; }
+    string payload;
+    uint32_t n = 0;
+    bool ok = true;
+    while (MYSQL_ROW row = mysql_fetch_row(res)) {
+        unsigned long *len = mysql_fetch_lengths(res);
+        put_record(payload, row[0] ? row[0] : "", row[0] ? len[0] : 0, row[1] ? row[1] : "", row[1] ? len[1] : 0);
+        n++;
+        if (payload.size() >= BLOCK_BYTES) {
+            if (!(ok = out.append(payload, n))) break;
+            rows += n;
+            payload.clear();
+            n = 0;
+        }
+    }
+    if (ok && mysql_errno(conn)) { ok = false; error = string("DB error: ") + mysql_error(conn); }   // stream broke off
+    else if (!ok) error = string("write failed: ") + strerror(errno);
+    mysql_free_result(res);
+    if (ok && n) {
+        if (!(ok = out.append(payload, n))) error = string("write failed: ") + strerror(errno);
+        else rows += n;
+    }
+    return ok;
+}
+
+int run_export(const SnapshotConfig &cfg) {
+    auto t0 = chrono::steady_clock::now();
+    auto endpoint = [&](int p) { return cfg.db_hosts[p % cfg.db_hosts.size()]; };
+    string error;
+
+    vector<Range> ranges;
+    for (int p = 0; p < cfg.partitions; p++) {
+        MYSQL *conn = connect_db(endpoint(p), EXPORT_TIMEOUT_S);
+        if (!conn) return 1;
+        bool ok = plan_ranges(conn, p, cfg.partitions, cfg.chunks, ranges, error);
+        mysql_close(conn);
+        if (!ok) { cerr << "Export failed: " << error << "\n"; return 1; }
+    }
+    cout << "Exporting " << cfg.partitions << " table(s) as " << ranges.size() << " ranges over " << cfg.threads << " connections\n";
+
+    SnapshotWriter out;
+    if (!out.open(cfg.file, error)) { cerr << "Export failed: " << error << "\n"; return 1; }
+    atomic<size_t> next{0};
+    atomic<uint64_t> rows{0};
+    mutex err_mu;
+    vector<thread> workers;
+    for (int t = 0; t < cfg.threads; t++) {
+        workers.emplace_back([&] {
+            mysql_thread_init();
+            vector<MYSQL *> conns(cfg.db_hosts.size(), nullptr);   // one per endpoint, opened on first use
+            for (size_t i; (i = next++) < ranges.size();) {
+                size_t e = ranges[i].partition % conns.size();
+                string err;
+                if (!conns[e] && !(conns[e] = connect_db(cfg.db_hosts[e], EXPORT_TIMEOUT_S))) err = "DB connection failed";
+                if (err.empty() && export_range(conns[e], ranges[i], cfg.partitions, out, rows, err)) continue;
+                lock_guard<mutex> lk(err_mu);
+                if (error.empty()) error = err;
+                next = ranges.size();                               // stop the other workers too
+            }
+            for (MYSQL *c : conns) if (c) mysql_close(c);
+            mysql_thread_end();
+        });
+    }
+    for (auto &w : workers) w.join();
+    if (error.empty()) out.finish(error);
+    if (!error.empty()) { cerr << "Export failed: " << error << "\n"; return 1; }
+
+    double secs = seconds_since(t0);
+    cout << fixed << setprecision(1) << "Exported " << out.records() << " rows, " << out.bytes() / 1048576.0 << " MB in "
+         << secs << " s (" << (secs > 0 ? out.records() / secs : 0.0) << " rows/s) to " << cfg.file << "\n";
+    return 0;
+}
+
+
+
+
+/*=============================================================
+                 import: sequential read, parallel writes
+================================================================*/
+unique_ptr<KVStore> open_target(const SnapshotConfig &cfg, string &error) {
+    if (cfg.backend == "mysql") {
+        auto s = make_unique<MySQLStore>(cfg.db_hosts, cfg.partitions, 2, 8, 30000);
+        if (!s->open(error)) return nullptr;
+        return s;
+    }
+    if (cfg.backend == "bitcask") {
+        BitcaskOptions opts;
+        opts.dir = cfg.data_dir + "/bitcask";
+        auto s = make_unique<BitcaskStore>(opts);
+        if (!s->open(error)) return nullptr;
+        return s;
+    }
+    if (cfg.backend == "lsm") {
+        LSMOptions opts;
+        opts.dir = cfg.data_dir + "/lsm";
+        auto s = make_unique<LSMStore>(opts);
+        if (!s->open(error)) return nullptr;
+        return s;
+    }
+    error = "unknown backend '" + cfg.backend + "'";
+    return nullptr;
+}
+
+struct Block {
+    string payload;
+    uint32_t records, crc;
+};
+
+int run_import(const SnapshotConfig &cfg, bool verify_only) {
+    auto t0 = chrono::steady_clock::now();
+    string error;
+    unique_ptr<KVStore> store;
+    if (!verify_only && !(store = open_target(cfg, error))) { cerr << "Import failed: " << error << "\n"; return 1; }
+
+    // reader → writers, bounded so a slow store does not pull the whole file into memory
+    mutex mu;
+    condition_variable cv;
+    deque<Block> queue;
+    bool done = false;
+    string failure;
+    atomic<uint64_t> written{0};
+    const size_t max_queued = 2 * cfg.threads;
+    auto fail = [&](const string &e) {
+        lock_guard<mutex> lk(mu);
+        if (failure.empty()) failure = e;
+        cv.notify_all();
+    };
+
+    vector<thread> writers;
+    for (int t = 0; t < cfg.threads; t++) {
+        writers.emplace_back([&] {
+            while (true) {
+                Block b;
+                {   unique_lock<mutex> lk(mu);
+                    cv.wait(lk, [&] { return !queue.empty() || done || !failure.empty(); });
+                    if (queue.empty() || !failure.empty()) return;
+                    b = std::move(queue.front());
+                    queue.pop_front();
+                }
+                cv.notify_all();
+                vector<pair<string, string>> kvs;
+                if (crc32(b.payload.data(), b.payload.size()) != b.crc || !decode_block(b.payload, b.records, kvs)) {
+                    fail("corrupt block (checksum mismatch)");
+                    return;
+                }
+                string err;
+                if (store && store->put_many(kvs, err) == StoreStatus::ERROR) { fail(err); return; }
+                written += kvs.size();
+            }
+        });
+    }
+
+    uint64_t records = 0, bytes = 0;
+    bool ok = read_snapshot(cfg.file, [&](string &&payload, uint32_t n, uint32_t crc) {
+        unique_lock<mutex> lk(mu);
+        cv.wait(lk, [&] { return queue.size() < max_queued || !failure.empty(); });
+        if (!failure.empty()) return false;
+        queue.push_back(Block{std::move(payload), n, crc});
+        cv.notify_all();
+        return true;
+    }, records, bytes, error);
+    {   lock_guard<mutex> lk(mu);
+        done = true;
+    }
+    cv.notify_all();
+    for (auto &w : writers) w.join();
+    if (!failure.empty()) error = failure;
+    if (!ok || !failure.empty()) { cerr << (verify_only ? "Verify" : "Import") << " failed: " << error << "\n"; return 1; }
+
+    double secs = seconds_since(t0);
+    cout << fixed << setprecision(1) << (verify_only ? "Verified " : "Imported ") << written << " rows, "
+         << bytes / 1048576.0 << " MB in " << secs << " s (" << (secs > 0 ? bytes / 1048576.0 / secs : 0.0) << " MB/s, "
+         << (secs > 0 ? written / secs : 0.0) << " rows/s)";
+    if (!verify_only) cout << " into " << store->name();
+    cout << "\n";
+    return 0;
+}
+
+
+
+
+int main(int argc, char *argv[]) {
+    SnapshotConfig cfg;
+    if (!parse_args(argc, argv, cfg)) return 1;
+    // the first connection is opened on this thread before any worker starts, which initializes the client library
+    return cfg.mode == "export" ? run_export(cfg) : run_import(cfg, cfg.mode == "verify");
+}
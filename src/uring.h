@@ -0,0 +1,198 @@
+#pragma once
+/*=============================================================
+        Minimal io_uring wrapper (raw syscalls, no liburing)
+ ===============================================================
+ Just what the event loops need: one submission / completion ring pair
+ mapped into the process, helpers that fill SQEs for accept, recv, sendmsg
+ and read, and a provided-buffer ring (IORING_REGISTER_PBUF_RING) the
+ kernel picks receive buffers from, so a multishot recv does not need a
+ buffer per connection posted in advance. Only the thread that owns the
+ ring may touch it.
+
+ Needs Linux 5.19+ (multishot accept, buffer rings); 6.0+ for multishot
+ recv. init() fails cleanly on older kernels or where io_uring is blocked
+ (seccomp, io_uring_disabled sysctl) and the caller falls back to epoll.
+================================================================*/
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class Uring {
+public:
+    Uring() = default;
+    Uring(const Uring &) = delete;
+    Uring &operator=(const Uring &) = delete;
+    ~Uring() { release(); }
+
+    // sets up the rings, false (errno set) if the kernel lacks what the event loops rely on
+    bool init(unsigned entries) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = entries * 4;                  // multishot ops post many completions per submission
+        fd_ = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (fd_ < 0) return false;
+        if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP)) {
+            release();
+            errno = ENOTSUP;
+            return false;
+        }
+        ring_bytes_ = std::max(p.sq_off.array + p.sq_entries * sizeof(unsigned), p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe));
+        ring_ = mmap(nullptr, ring_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        sqes_bytes_ = p.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (ring_ == MAP_FAILED || sqes == MAP_FAILED) {
+            if (sqes != MAP_FAILED) munmap(sqes, sqes_bytes_);
+            if (ring_ == MAP_FAILED) ring_ = nullptr;
+            release();
+            return false;
+        }
+        char *r = (char *)ring_;
+        sqes_ = (io_uring_sqe *)sqes;
+        sq_head_ = (unsigned *)(r + p.sq_off.head);
+        sq_tail_ = (unsigned *)(r + p.sq_off.tail);
+        sq_mask_ = *(unsigned *)(r + p.sq_off.ring_mask);
+        sq_entries_ = p.sq_entries;
+        unsigned *array = (unsigned *)(r + p.sq_off.array);
+        for (unsigned i = 0; i < p.sq_entries; i++) array[i] = i;   // SQE i always sits in slot i
+        cq_head_ = (unsigned *)(r + p.cq_off.head);
+        cq_tail_ = (unsigned *)(r + p.cq_off.tail);
+        cq_mask_ = *(unsigned *)(r + p.cq_off.ring_mask);
+        cqes_ = (io_uring_cqe *)(r + p.cq_off.cqes);
+        tail_ = *sq_tail_;
+        return true;
+    }
+
+    // registers `count` buffers of `size` bytes as provided-buffer group `group`
+    bool init_buffers(unsigned count, unsigned size, uint16_t group) {
+        buf_count_ = count;                          // power of two
+        buf_size_ = size;
+        buf_group_ = group;
+        buf_ring_bytes_ = count * sizeof(io_uring_buf);
+        void *ring = mmap(nullptr, buf_ring_bytes_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED) return false;
+        buf_ring_ = (io_uring_buf_ring *)ring;
+        buffers_.resize((size_t)count * size);
+        io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = (uint64_t)(uintptr_t)buf_ring_;
+        reg.ring_entries = count;
+        reg.bgid = group;
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return false;
+        for (unsigned i = 0; i < count; i++) recycle(i);
+        return true;
+    }
+
+    const char *buffer(unsigned bid) const { return &buffers_[(size_t)bid * buf_size_]; }
+
+    // hands buffer `bid` back to the kernel once its bytes were copied out
+    void recycle(unsigned bid) {
+        // not buf_ring_->bufs[]: in C++ the header's flexible array macro puts it at offset 8 instead of 0
+        io_uring_buf *b = (io_uring_buf *)buf_ring_ + (buf_tail_ & (buf_count_ - 1));
+        b->addr = (uint64_t)(uintptr_t)buffer(bid);
+        b->len = buf_size_;
+        b->bid = (uint16_t)bid;
+        buf_tail_++;
+        __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+    }
+
+    void accept_multishot(int listen_fd, uint64_t user_data) {
+        io_uring_sqe *s = sqe(IORING_OP_ACCEPT, listen_fd, user_data);
+        s->ioprio = IORING_ACCEPT_MULTISHOT;
+        s->accept_flags = SOCK_CLOEXEC;              // blocking sockets: the ring does the waiting
+    }
+
+    void recv_multishot(int fd, uint64_t user_data) {
+        io_uring_sqe *s = sqe(IORING_OP_RECV, fd, user_data);
+        s->ioprio = IORING_RECV_MULTISHOT;
+        s->flags = IOSQE_BUFFER_SELECT;
+        s->buf_group = buf_group_;
+    }
+
+    // `msg` and its iovecs must stay valid until the completion arrives
+    void sendmsg(int fd, const msghdr *msg, uint64_t user_data) {
+        io_uring_sqe *s = sqe(IORING_OP_SENDMSG, fd, user_data);
+        s->addr = (uint64_t)(uintptr_t)msg;
+        s->len = 1;
+        s->msg_flags = MSG_NOSIGNAL;
+    }
+
+    void read(int fd, void *data, size_t len, uint64_t user_data) {
+        io_uring_sqe *s = sqe(IORING_OP_READ, fd, user_data);
+        s->addr = (uint64_t)(uintptr_t)data;
+        s->len = (unsigned)len;
+        s->off = (uint64_t)-1;                       // current position (eventfd / pipes)
+    }
+
+    // submits what was queued and sleeps until at least one completion is there: one syscall
+    int submit_and_wait() {
+        unsigned n = tail_ - submitted_;
+        __atomic_store_n(sq_tail_, tail_, __ATOMIC_RELEASE);
+        submitted_ = tail_;
+        enters_++;
+        int r = (int)syscall(__NR_io_uring_enter, fd_, n, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        return r < 0 && errno != EINTR && errno != EBUSY ? -1 : 0;
+    }
+
+    // calls fn(cqe) for every completion available, then frees their slots
+    template <typename Fn> void for_each_completion(Fn fn) {
+        unsigned head = *cq_head_, tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) fn(cqes_[head & cq_mask_]);
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+
+    long enters() const { return enters_; }
+
+private:
+    // next free SQE, flushing the queue to the kernel first if it is full
+    io_uring_sqe *sqe(uint8_t op, int fd, uint64_t user_data) {
+        if (tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+            unsigned n = tail_ - submitted_;
+            __atomic_store_n(sq_tail_, tail_, __ATOMIC_RELEASE);
+            submitted_ = tail_;
+            enters_++;
+            syscall(__NR_io_uring_enter, fd_, n, 0, 0, nullptr, 0);
+        }
+        io_uring_sqe *s = &sqes_[tail_ & sq_mask_];
+        tail_++;
+        memset(s, 0, sizeof(*s));
+        s->opcode = op;
+        s->fd = fd;
+        s->user_data = user_data;
+        return s;
+    }
+
+    void release() {
+        if (buf_ring_) munmap(buf_ring_, buf_ring_bytes_);
+        if (sqes_) munmap(sqes_, sqes_bytes_);
+        if (ring_) munmap(ring_, ring_bytes_);
+        if (fd_ >= 0) close(fd_);
+        buf_ring_ = nullptr;
+        sqes_ = nullptr;
+        ring_ = nullptr;
+        fd_ = -1;
+    }
+
+    int fd_ = -1;
+    void *ring_ = nullptr;
+    size_t ring_bytes_ = 0, sqes_bytes_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    unsigned *sq_head_ = nullptr, *sq_tail_ = nullptr, sq_mask_ = 0, sq_entries_ = 0;
+    unsigned tail_ = 0, submitted_ = 0;          // SQEs filled / handed to the kernel
+    unsigned *cq_head_ = nullptr, *cq_tail_ = nullptr, cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+    long enters_ = 0;
+
+    io_uring_buf_ring *buf_ring_ = nullptr;
+    size_t buf_ring_bytes_ = 0;
+    unsigned buf_count_ = 0, buf_size_ = 0;
+    uint16_t buf_group_ = 0, buf_tail_ = 0;
+    std::vector<char> buffers_;
+};
@@ -0,0 +1,259 @@
+#pragma once
+/*=============================================================
+        Worker pool behind httplib's accept loop (new_task_queue)
+ ===============================================================
+ httplib hands every accepted connection to a TaskQueue; its own
+ ThreadPool has a compile-time size (CPPHTTPLIB_THREAD_POOL_COUNT) and an
+ unbounded job list. This one is sized at startup, can refuse connections
+ beyond max_queue (httplib then closes the socket right away, which beats
+ letting them time out in a queue nobody drains) and can pin each worker
+ to one CPU. A task is a whole keep-alive connection, so "queued" is the
+ time from accept() until a worker picks the connection up.
+
+ Two schedulers:
+  - shared:   one deque, one mutex and one condition variable for all
+              workers, the same design as httplib's ThreadPool.
+  - stealing: every worker owns a deque with its own lock. enqueue() hands
+              the job straight to a parked worker if there is one (and wakes
+              only that worker), otherwise it appends to the next worker's
+              deque round robin. A worker that runs dry takes jobs from the
+              back of the others' deques before it parks. Workers announce
+              themselves as parked *before* their last look at the deques,
+              and enqueue() looks for parked workers *after* pushing, so a
+              job is never left behind a busy worker while another sleeps.
+================================================================*/
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+#include "httplib.h"
+#include "latency.h"
+
+// CPUs this process may run on, in ascending order
+inline std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+    for (int c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &set)) cpus.push_back(c);
+    return cpus;
+}
+
+// restricts `t` to one CPU, `what` names the thread in the warning
+inline void pin_thread(std::thread &t, int cpu, const char *what) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+    if (rc != 0) std::cerr << "Cannot pin " << what << " to CPU " << cpu << ": " << strerror(rc) << "\n";
+}
+
+
+struct WorkerPoolOptions {
+    int workers = CPPHTTPLIB_THREAD_POOL_COUNT;   // threads serving connections
+    size_t max_queue = 0;              // accepted connections waiting for a worker, 0 = unbounded
+    bool pin = false;                  // worker i runs only on the i-th CPU this process may use (mod count)
+    bool stealing = true;              // per-worker deques + work stealing, false = one shared queue
+};
+
+
+class WorkerPool {
+public:
+    explicit WorkerPool(WorkerPoolOptions opts) : opts_(opts) {
+        opts_.workers = std::max(1, opts_.workers);
+        for (int i = 0; i < opts_.workers; i++) workers_.emplace_back(new Worker);
+        std::vector<int> cpus = allowed_cpus();
+        for (int i = 0; i < opts_.workers; i++) {
+            threads_.emplace_back([this, i] { if (opts_.stealing) work_stealing(i); else work_shared(); });
+            if (opts_.pin && !cpus.empty()) pin_thread(threads_.back(), cpus[i % cpus.size()], "worker");
+        }
+    }
+
+    ~WorkerPool() { stop(); }
+
+    // for server.new_task_queue: httplib deletes what it gets, so it gets a handle to this pool
+    httplib::TaskQueue *task_queue() { return new Handle(*this); }
+
+    bool enqueue(std::function<void()> fn) {
+        size_t depth = queued_.fetch_add(1) + 1;
+        if (stopping_ || (opts_.max_queue && depth > opts_.max_queue)) {
+            queued_--;
+            rejected_++;
+            return false;
+        }
+        size_t seen = max_depth_.load(std::memory_order_relaxed);
+        while (depth > seen && !max_depth_.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {}
+        Job job{std::move(fn), std::chrono::steady_clock::now()};
+
+        if (!opts_.stealing) {
+            {   std::lock_guard<std::mutex> lk(mu_);
+                jobs_.push_back(std::move(job));
+            }
+            cv_.notify_one();
+            return true;
+        }
+        size_t start = next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+        int idle = claim_parked(start);
+        Worker &w = *workers_[idle >= 0 ? idle : start];
+        {   std::lock_guard<std::mutex> lk(w.mu);
+            w.jobs.push_back(std::move(job));
+            w.size++;
+        }
+        if (idle < 0) idle = claim_parked(start);   // someone went idle meanwhile: it steals the job
+        if (idle >= 0) wake(*workers_[idle]);
+        return true;
+    }
+
+    // lets the workers finish the queued connections, then joins them
+    void stop() {
+        if (stopping_.exchange(true)) return;
+        {   std::lock_guard<std::mutex> lk(mu_); }             // a shared-queue worker is either waiting or sees stopping_
+        cv_.notify_all();
+        for (auto &w : workers_) wake(*w);
+        for (auto &t : threads_) t.join();
+    }
+
+    std::string stats_json() const {
+        std::stringstream ss;
+        ss << "{\"scheduler\": \"" << (opts_.stealing ? "stealing" : "shared") << "\", \"workers\": " << threads_.size()
+           << ", \"busy\": " << busy_ << ", \"pinned\": " << (opts_.pin ? "true" : "false")
+           << ", \"queue_depth\": " << queued_ << ", \"max_queue_depth\": " << max_depth_
+           << ", \"queue_limit\": " << opts_.max_queue << ", \"rejected\": " << rejected_ << ", \"steals\": " << steals_
+           << ", \"queued\": " << queue_wait_.stats_json() << "}";
+        return ss.str();
+    }
+
+private:
+    struct Job {
+        std::function<void()> fn;
+        std::chrono::steady_clock::time_point queued_at;
+    };
+
+    struct Worker {
+        std::mutex mu;                       // guards jobs and wake
+        std::condition_variable cv;
+        std::deque<Job> jobs;                // owner pops the front, thieves take the back
+        std::atomic<size_t> size{0};         // jobs.size(), readable without the lock
+        std::atomic<bool> parked{false};     // sleeping or about to, claimed by enqueue() with a CAS
+        bool wake = false;
+    };
+
+    class Handle : public httplib::TaskQueue {
+    public:
+        explicit Handle(WorkerPool &pool) : pool_(pool) {}
+        bool enqueue(std::function<void()> fn) override { return pool_.enqueue(std::move(fn)); }
+        void shutdown() override { pool_.stop(); }
+    private:
+        WorkerPool &pool_;
+    };
+
+    void run(Job &job) {
+        queued_--;
+        busy_++;
+        queue_wait_.record(std::chrono::steady_clock::now() - job.queued_at);
+        job.fn();
+        busy_--;
+    }
+
+    void work_shared() {
+        std::unique_lock<std::mutex> lk(mu_);
+        while (true) {
+            cv_.wait(lk, [&] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) return;                    // stopping and drained
+            Job job = std::move(jobs_.front());
+            jobs_.pop_front();
+            lk.unlock();
+            run(job);
+            lk.lock();
+        }
+    }
+
+    void work_stealing(int self) {
+        Worker &me = *workers_[self];
+        Job job;
+        while (true) {
+            if (take(self, job)) { run(job); continue; }
+            if (stopping_) return;                        // stopping and drained
+            me.parked = true;
+            parked_count_++;
+            if (take(self, job)) {                        // pushed just before we were visible as parked
+                if (me.parked.exchange(false)) parked_count_--;
+                run(job);
+                continue;
+            }
+            {   std::unique_lock<std::mutex> lk(me.mu);
+                me.cv.wait(lk, [&] { return me.wake || me.size > 0 || stopping_; });
+                me.wake = false;
+            }
+            if (me.parked.exchange(false)) parked_count_--;
+        }
+    }
+
+    // own deque first, then the back of the others' (starting next door so thieves spread out)
+    bool take(int self, Job &job) {
+        size_t n = workers_.size();
+        for (size_t k = 0; k < n; k++) {
+            Worker &w = *workers_[(self + k) % n];
+            if (w.size == 0) continue;
+            std::lock_guard<std::mutex> lk(w.mu);
+            if (w.jobs.empty()) continue;
+            if (k == 0) {
+                job = std::move(w.jobs.front());
+                w.jobs.pop_front();
+            } else {
+                job = std::move(w.jobs.back());
+                w.jobs.pop_back();
+                steals_++;
+            }
+            w.size--;
+            return true;
+        }
+        return false;
+    }
+
+    // a parked worker, now owned by the caller (who must wake() it), or -1
+    int claim_parked(size_t start) {
+        if (parked_count_ == 0) return -1;
+        size_t n = workers_.size();
+        for (size_t k = 0; k < n; k++) {
+            size_t i = (start + k) % n;
+            bool expected = true;
+            if (workers_[i]->parked && workers_[i]->parked.compare_exchange_strong(expected, false)) {
+                parked_count_--;
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    static void wake(Worker &w) {
+        {   std::lock_guard<std::mutex> lk(w.mu);
+            w.wake = true;
+        }
+        w.cv.notify_one();
+    }
+
+    WorkerPoolOptions opts_;
+    std::mutex mu_;                                 // shared scheduler: guards jobs_
+    std::condition_variable cv_;
+    std::deque<Job> jobs_;
+    std::vector<std::unique_ptr<Worker>> workers_;  // stealing scheduler
+    std::atomic<size_t> next_{0}, parked_count_{0};
+    std::vector<std::thread> threads_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<size_t> queued_{0}, busy_{0}, max_depth_{0};
+    std::atomic<long> rejected_{0}, steals_{0};
+    LatencyHistogram queue_wait_;                   // accept → picked up by a worker
+};
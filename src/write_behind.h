@@ -0,0 +1,178 @@
+#pragma once
+/*=============================================================
+        Write-behind queue for "X-Durability: async" writes
+ ===============================================================
+ Handlers record the latest value (or a delete) of a key and return right
+ away. One background thread hands everything pending to the store every
+ flush_ms, or as soon as max_batch keys are waiting, with a single
+ put_many() plus one erase() per deleted key, so repeated writes of a key
+ between two flushes collapse into one statement.
+
+ Until its write has reached the store a key is answered from here
+ (lookup()), so evicting it from the cache loses nothing. A failed flush
+ puts the batch back and is retried; a crash drops whatever was pending.
+================================================================*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <sstream>
+#include "kv_store.h"
+
+struct WriteBehindOptions {
+    int flush_ms = 10;                 // longest a write waits before it is sent to the store
+    size_t max_batch = 4096;           // flush early once this many keys are waiting
+    size_t max_pending = 200000;       // enqueue() refuses beyond this, e.g. while the store is down
+    std::function<bool()> allow;       // false = leave everything queued for now (circuit breaker open)
+    std::function<void(bool ok, std::chrono::steady_clock::duration)> record;  // result of every store call
+    std::function<void(const std::string &key)> erased;                        // a queued delete removed a row
+};
+
+
+class WriteBehind {
+public:
+    enum class Pending { NONE, PUT, DELETE };
+
+    WriteBehind(KVStore &store, WriteBehindOptions opts) : store_(store), opts_(std::move(opts)) {
+        flusher_ = std::thread([this] { flush_loop(); });
+    }
+
+    ~WriteBehind() {
+        {   std::lock_guard<std::mutex> lk(mu_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        flusher_.join();
+    }
+
+    // queue the new value of `key` (nullptr = delete), false when the queue is full
+    bool enqueue(const std::string &key, const std::string *value) {
+        std::lock_guard<std::mutex> lk(mu_);
+        auto it = pending_.find(key);
+        if (it == pending_.end()) {
+            if (pending_.size() >= opts_.max_pending) { refused_++; return false; }
+            it = pending_.emplace(key, Op()).first;
+        } else {
+            coalesced_++;
+        }
+        it->second.del = !value;
+        it->second.value = value ? *value : std::string();
+        queued_++;
+        if (pending_.size() >= opts_.max_batch) cv_.notify_all();
+        return true;
+    }
+
+    // queued write of `key` that has not reached the store yet
+    Pending lookup(const std::string &key, std::string &value) const {
+        std::lock_guard<std::mutex> lk(mu_);
+        for (auto *m : {&pending_, &flushing_}) {          // pending_ holds the newer write
+            auto it = m->find(key);
+            if (it == m->end()) continue;
+            if (it->second.del) return Pending::DELETE;
+            value = it->second.value;
+            return Pending::PUT;
+        }
+        return Pending::NONE;
+    }
+
+    // a synchronous write of `key` is about to go to the store: drop the older queued write and wait
+    // for the batch in flight, so neither can land on top of it afterwards
+    void supersede(const std::string &key) {
+        std::unique_lock<std::mutex> lk(mu_);
+        while (true) {
+            if (pending_.erase(key)) superseded_++;
+            if (!flushing_.count(key)) return;
+            flushed_cv_.wait(lk);                           // a failed batch is put back into pending_
+        }
+    }
+
+    std::string stats_json() const {
+        std::lock_guard<std::mutex> lk(mu_);
+        std::stringstream ss;
+        ss << "{\"pending\": " << pending_.size() + flushing_.size() << ", \"queued\": " << queued_
+           << ", \"coalesced\": " << coalesced_ << ", \"superseded\": " << superseded_ << ", \"refused\": " << refused_
+           << ", \"flushed\": " << flushed_ << ", \"batches\": " << batches_ << ", \"failed_batches\": " << failed_ << "}";
+        return ss.str();
+    }
+
+private:
+    struct Op {
+        bool del = false;
+        std::string value;
+    };
+
+    void flush_loop() {
+        std::unique_lock<std::mutex> lk(mu_);
+        while (true) {
+            cv_.wait_for(lk, std::chrono::milliseconds(opts_.flush_ms), [&] { return stopping_ || pending_.size() >= opts_.max_batch; });
+            if (pending_.empty()) { if (stopping_) return; continue; }
+            if (opts_.allow && !opts_.allow()) {
+                if (stopping_) return;
+                cv_.wait_for(lk, std::chrono::milliseconds(100));   // store is out, do not spin on allow()
+                continue;
+            }
+            flushing_.swap(pending_);
+            lk.unlock();
+            std::vector<std::pair<std::string, std::string>> puts;
+            std::vector<const std::string *> dels;
+            for (auto &kv : flushing_) {                     // flushing_ is only changed by this thread
+                if (kv.second.del) dels.push_back(&kv.first);
+                else puts.emplace_back(kv.first, kv.second.value);
+            }
+            size_t done = write(puts, dels);
+            lk.lock();
+            if (done == puts.size() + dels.size()) {
+                flushed_ += done;
+            } else {
+                // put_many() is all or nothing, the deletes run in order: requeue what did not reach the store
+                // unless a newer write of the key was queued meanwhile (writes are idempotent, retrying is safe)
+                failed_++;
+                flushed_ += done;
+                for (size_t i = (done >= puts.size() ? done - puts.size() : 0); i < dels.size(); i++)
+                    pending_.emplace(*dels[i], Op{true, std::string()});
+                if (done < puts.size())
+                    for (auto &kv : puts) pending_.emplace(std::move(kv.first), Op{false, std::move(kv.second)});
+            }
+            flushing_.clear();
+            batches_++;
+            flushed_cv_.notify_all();
+        }
+    }
+
+    // put_many() for the values, then the deletes one by one; returns how many ops reached the store
+    // (all puts or none of them, then the deletes that went through)
+    size_t write(const std::vector<std::pair<std::string, std::string>> &puts, const std::vector<const std::string *> &dels) {
+        std::string error;
+        if (!puts.empty()) {
+            auto t0 = std::chrono::steady_clock::now();
+            bool ok = store_.put_many(puts, error) != StoreStatus::ERROR;
+            if (opts_.record) opts_.record(ok, std::chrono::steady_clock::now() - t0);
+            if (!ok) { std::cerr << "Write-behind flush failed: " << error << "\n"; return 0; }
+        }
+        size_t n = puts.size();
+        for (const std::string *key : dels) {
+            auto t0 = std::chrono::steady_clock::now();
+            StoreStatus st = store_.erase(*key, error);
+            if (opts_.record) opts_.record(st != StoreStatus::ERROR, std::chrono::steady_clock::now() - t0);
+            if (st == StoreStatus::ERROR) { std::cerr << "Write-behind delete failed: " << error << "\n"; return n; }
+            if (st == StoreStatus::OK && opts_.erased) opts_.erased(*key);
+            n++;
+        }
+        return n;
+    }
+
+    KVStore &store_;
+    const WriteBehindOptions opts_;
+    mutable std::mutex mu_;                         // guards both maps and the counters
+    std::condition_variable cv_, flushed_cv_;
+    std::unordered_map<std::string, Op> pending_;   // latest queued write per key
+    std::unordered_map<std::string, Op> flushing_;  // batch being written right now, still answered by lookup()
+    bool stopping_ = false;
+    long queued_ = 0, coalesced_ = 0, superseded_ = 0, refused_ = 0, flushed_ = 0, batches_ = 0, failed_ = 0;
+    std::thread flusher_;
+};